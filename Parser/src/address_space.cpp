@@ -1 +0,0 @@
-#include "address_space.hpp"
@@ -1,9 +0,0 @@
-#include <string>
-#include <cstdint>
-class AddressSpace   {
-    public:
-    int current_max_address = 900;
-    int op_start_address = 901;
-    int frame_size = 100;
-
-};
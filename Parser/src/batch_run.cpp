@@ -0,0 +1,63 @@
+// Runs a corpus of .o programs on VMBatch and writes one result line each.
+// Usage: batch_run <manifest | directory>... [--threads=N] [--repeat=N]
+//                  [--dispatch=switch|threaded|jit] [--no-fusion] [--no-fold]
+//                  [--results=FILE]
+#include "vm_batch.hpp"
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <manifest | directory>... [--threads=N] [--repeat=N]"
+                  << " [--dispatch=switch|threaded|jit] [--no-fusion] [--no-fold] [--results=FILE]" << std::endl;
+        return 1;
+    }
+    try {
+        VMBatch batch;
+        std::string results_filename = "batch_results.tsv";
+        for (int i = 1; i < argc; ++i) {
+            const std::string option = argv[i];
+            if (option.rfind("--threads=", 0) == 0) {
+                batch.setThreads(static_cast<unsigned>(std::strtoul(option.c_str() + 10, nullptr, 10)));
+            } else if (option.rfind("--repeat=", 0) == 0) {
+                batch.setRepeat(static_cast<unsigned>(std::strtoul(option.c_str() + 9, nullptr, 10)));
+            } else if (option == "--dispatch=switch") {
+                batch.setDispatchMode(VMSimulator::DispatchMode::Switch);
+            } else if (option == "--dispatch=threaded") {
+                batch.setDispatchMode(VMSimulator::DispatchMode::Threaded);
+            } else if (option == "--dispatch=jit") {
+                batch.setDispatchMode(VMSimulator::DispatchMode::Jit);
+            } else if (option == "--no-fusion") {
+                batch.setFusion(false);
+            } else if (option == "--no-fold") {
+                batch.setFolding(false);
+            } else if (option.rfind("--results=", 0) == 0) {
+                results_filename = option.substr(10);
+            } else if (option.rfind("--", 0) == 0) {
+                std::cerr << "Unknown option: " << option << std::endl;
+                return 1;
+            } else {
+                batch.addInputs(option);
+            }
+        }
+
+        batch.run();
+        std::ofstream results(results_filename);
+        if (!results.is_open()) {
+            throw std::runtime_error("Cannot open results file: " + results_filename);
+        }
+        batch.writeResults(results);
+        batch.writeSummary(std::cout);
+        std::cout << "Results written to " << results_filename << std::endl;
+        for (const auto& result : batch.getResults()) {
+            if (!result.ok) return 1;
+        }
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,225 @@
+#include "bytecode_verifier.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+std::runtime_error verifyError(const ControlFlowGraph& cfg, size_t index, const std::string& what) {
+    return std::runtime_error(what + " at offset " + std::to_string(cfg.offsetOf(index)));
+}
+
+bool isLocalAccess(const std::string& name) {
+    return name == "ILOAD" || name == "ISTORE" || name == "LOAD" || name == "STORE";
+}
+
+} // namespace
+
+bool stackEffect(const std::string& name, int& pops, int& pushes) {
+    static const struct {
+        const char* name;
+        int pops;
+        int pushes;
+    } kEffects[] = {
+        {"ICONST", 0, 1}, {"ILOAD", 0, 1}, {"LOAD", 0, 1},
+        {"ISTORE", 1, 0}, {"STORE", 1, 0}, {"POP", 1, 0}, {"DUP", 1, 2},
+        {"IADD", 2, 1}, {"ISUB", 2, 1}, {"IMUL", 2, 1}, {"IDIV", 2, 1},
+        {"icmp_eq", 2, 1}, {"icmp_lt", 2, 1}, {"icmp_gt", 2, 1}, {"ICMP", 2, 1},
+        {"JMP", 0, 0}, {"jmp_if_false", 1, 0}, {"JMP_IF_ZERO", 1, 0}, {"JNZ", 1, 0},
+        {"INVOKE", 0, 0}, {"RET", 0, 0},
+        {"NEW_ARRAY", 1, 1}, {"NEW_STRING", 1, 1}, {"SET_ELEM", 3, 0}, {"SET_CHAR", 3, 0},
+        {"GET_ELEM", 2, 1}, {"GET_CHAR", 2, 1}, {"PRINT_I", 1, 0}, {"PRINT_S", 1, 0},
+    };
+    for (const auto& e : kEffects) {
+        if (name == e.name) {
+            pops = e.pops;
+            pushes = e.pushes;
+            return true;
+        }
+    }
+    return false;
+}
+
+BytecodeVerifier::BytecodeVerifier() : max_stack(0), max_call_depth(0), stack_per_call(0), recursive(false) {}
+
+BytecodeVerifier::BytecodeVerifier(const std::vector<Instruction>& instructions, const ControlFlowGraph& cfg, size_t call_limit)
+    : max_stack(0), max_call_depth(0), stack_per_call(0), recursive(false) {
+    const size_t n = cfg.size();
+    const size_t function_count = cfg.functions().size();
+    heights.assign(n, -1);
+    function_info.assign(function_count, Function{false, false, 0, -1, -1});
+    if (n == 0) return;
+
+    // A function must return the same number of values everywhere only if
+    // something calls it; main's RET just stops the machine
+    for (size_t i = 0; i < n; ++i) {
+        if (instructions[i].name != "INVOKE") continue;
+        if (static_cast<size_t>(cfg.targetOf(i)) >= n) throw verifyError(cfg, i, "INVOKE of the end of the code");
+        if (instructions[i].operands.size() < 2 || instructions[i].operands[1] < 0) {
+            throw verifyError(cfg, i, "Bad argument count for INVOKE");
+        }
+        function_info[cfg.functionOf(cfg.targetOf(i))].called = true;
+    }
+
+    size_t main_function = 0;
+    for (size_t f = 0; f < function_count; ++f) {
+        if (cfg.functions()[f].is_main) main_function = f;
+    }
+    function_info[main_function].reachable = true;
+
+    // What an INVOKE pushes is unknown until its callee has reached a RET,
+    // so paths stop at such calls and the functions are analysed again
+    // until nothing new is learned. Each pass fixes a return height or
+    // reaches a new function, so this ends.
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t f = 0; f < function_count; ++f) {
+            if (function_info[f].reachable && analyse(instructions, cfg, f)) changed = true;
+        }
+    }
+
+    need_of.assign(function_count, -1);
+    calls_of.assign(function_count, 0);
+    visiting.assign(function_count, false);
+    max_stack = need(instructions, cfg, main_function);
+    max_call_depth = calls_of[main_function];
+    if (recursive) {
+        // Every frame but the innermost sits at a call, holding at most the
+        // highest height any INVOKE leaves behind it
+        int site = 0;
+        int local = 0;
+        for (size_t i = 0; i < n; ++i) {
+            if (heights[i] >= 0 && instructions[i].name == "INVOKE") {
+                site = std::max(site, heights[i] - instructions[i].operands[1]);
+            }
+        }
+        for (const Function& info : function_info) {
+            if (info.reachable) local = std::max(local, info.max_height);
+        }
+        max_stack = call_limit * site + local;
+        max_call_depth = call_limit;
+        stack_per_call = site;
+    }
+}
+
+// Walks function `f` from its entry with an empty stack. Returns true when
+// it learned a return height or reached a function not analysed before.
+bool BytecodeVerifier::analyse(const std::vector<Instruction>& instructions, const ControlFlowGraph& cfg, size_t f) {
+    const ControlFlowGraph::Function& fn = cfg.functions()[f];
+    Function& info = function_info[f];
+    bool changed = false;
+    std::fill(heights.begin() + fn.first, heights.begin() + fn.end, -1);
+
+    std::vector<size_t> work;
+    auto reach = [&](size_t from, size_t to, int height) {
+        if (to >= cfg.size()) return; // running off the end of the code stops the machine
+        if (to < fn.first || to >= fn.end) throw verifyError(cfg, from, "Control leaves its function");
+        if (heights[to] < 0) {
+            heights[to] = height;
+            work.push_back(to);
+        } else if (heights[to] != height) {
+            throw verifyError(cfg, to, "Stack height " + std::to_string(heights[to]) + " or " +
+                                       std::to_string(height) + " depending on the path");
+        }
+    };
+    reach(fn.first, fn.first, 0);
+
+    while (!work.empty()) {
+        size_t i = work.back();
+        work.pop_back();
+        const Instruction& instr = instructions[i];
+        int height = heights[i];
+        if (isLabelPseudo(instr.name)) {
+            reach(i, i + 1, height);
+            continue;
+        }
+
+        int pops = 0;
+        int pushes = 0;
+        if (!stackEffect(instr.name, pops, pushes)) throw verifyError(cfg, i, "Unknown instruction " + instr.name);
+        if (isLocalAccess(instr.name)) {
+            if (instr.operands.empty() || instr.operands[0] < 0) throw verifyError(cfg, i, "Bad local index in " + instr.name);
+            info.max_local = std::max(info.max_local, instr.operands[0]);
+        }
+        if (instr.name == "INVOKE") {
+            Function& callee = function_info[cfg.functionOf(cfg.targetOf(i))];
+            pops = instr.operands[1];
+            callee.max_local = std::max(callee.max_local, pops - 1);
+            if (!callee.reachable) {
+                callee.reachable = true;
+                changed = true;
+            }
+            if (callee.return_height < 0) {
+                if (height < pops) throw verifyError(cfg, i, "Stack underflow for INVOKE");
+                continue; // resumed once the callee is known to return
+            }
+            pushes = callee.return_height;
+        }
+        if (height < pops) throw verifyError(cfg, i, "Stack underflow for " + instr.name);
+        int after = height - pops + pushes;
+        info.max_height = std::max(info.max_height, std::max(height, after));
+
+        if (instr.name == "RET") {
+            if (!info.called) continue;
+            if (info.return_height < 0) {
+                info.return_height = height;
+                changed = true;
+            } else if (info.return_height != height) {
+                throw verifyError(cfg, i, "RET leaves " + std::to_string(height) + " values where another RET leaves " +
+                                          std::to_string(info.return_height));
+            }
+            continue;
+        }
+        if (isBranch(instr.name)) reach(i, static_cast<size_t>(cfg.targetOf(i)), after);
+        if (instr.name != "JMP") reach(i, i + 1, after);
+    }
+    return changed;
+}
+
+// Stack needed by `f` and everything it calls, from its entry height
+size_t BytecodeVerifier::need(const std::vector<Instruction>& instructions, const ControlFlowGraph& cfg, size_t f) {
+    if (need_of[f] >= 0) return static_cast<size_t>(need_of[f]);
+    if (visiting[f]) {
+        recursive = true;
+        return 0;
+    }
+    visiting[f] = true;
+    const ControlFlowGraph::Function& fn = cfg.functions()[f];
+    size_t deepest = static_cast<size_t>(function_info[f].max_height);
+    int calls = 0;
+    for (size_t i = fn.first; i < fn.end; ++i) {
+        if (heights[i] < 0 || instructions[i].name != "INVOKE") continue;
+        size_t callee = cfg.functionOf(cfg.targetOf(i));
+        size_t below = static_cast<size_t>(heights[i] - instructions[i].operands[1]);
+        deepest = std::max(deepest, below + need(instructions, cfg, callee));
+        calls = std::max(calls, calls_of[callee] + 1);
+    }
+    visiting[f] = false;
+    need_of[f] = static_cast<int>(deepest);
+    calls_of[f] = calls;
+    return deepest;
+}
+
+int BytecodeVerifier::heightAt(size_t index) const {
+    return index < heights.size() ? heights[index] : -1;
+}
+
+size_t BytecodeVerifier::maxStack() const {
+    return max_stack;
+}
+
+size_t BytecodeVerifier::maxCallDepth() const {
+    return max_call_depth;
+}
+
+size_t BytecodeVerifier::stackPerCall() const {
+    return stack_per_call;
+}
+
+bool BytecodeVerifier::isRecursive() const {
+    return recursive;
+}
+
+const std::vector<BytecodeVerifier::Function>& BytecodeVerifier::functions() const {
+    return function_info;
+}
@@ -0,0 +1,71 @@
+#ifndef BYTECODE_VERIFIER_HPP
+#define BYTECODE_VERIFIER_HPP
+
+#include "control_flow.hpp"
+#include "parser.hpp"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Values an instruction pops and pushes, by parser name. INVOKE pops its
+// argument count and pushes whatever the callee leaves, so it reports
+// (0, 0) here. Returns false for names that are not instructions.
+bool stackEffect(const std::string& name, int& pops, int& pushes);
+
+// Static check of the operand stack, run once at load time over a
+// ControlFlowGraph. Heights come from abstract interpretation: every
+// instruction has one stack height before it, counted from the entry of
+// its function, and every path that reaches it must agree. INVOKE pops its
+// arguments and pushes what the callee leaves at RET, which must be the
+// same at every RET of a function that is called. A function may not pop
+// below the height it was entered with.
+//
+// Only code reachable from the entry point and the INVOKE targets it
+// reaches is checked. A program that passes can neither underflow its
+// operand stack nor hold more than maxStack() values on it while at most
+// `call_limit` calls are nested, so the simulator runs it unchecked.
+class BytecodeVerifier {
+public:
+    struct Function {
+        bool reachable;
+        bool called;        // some reachable INVOKE targets it
+        int max_height;     // deepest operand stack inside it, from its entry height
+        int return_height;  // values it leaves at RET; -1 until one is reached
+        int max_local;      // highest local index it reads, writes or receives as an argument; -1 for none
+    };
+
+    BytecodeVerifier();
+    // Throws std::runtime_error naming the byte offset of the first problem
+    BytecodeVerifier(const std::vector<Instruction>& instructions, const ControlFlowGraph& cfg, size_t call_limit);
+
+    // Height before instruction `index`, from its function's entry; -1
+    // where nothing reaches. A label pseudo-instruction has the height of
+    // what follows it.
+    int heightAt(size_t index) const;
+    // Operand stack capacity the program can need. Exact when no function
+    // is recursive; otherwise a bound for `call_limit` nested calls.
+    size_t maxStack() const;
+    // Deepest INVOKE nesting: exact without recursion, else `call_limit`
+    size_t maxCallDepth() const;
+    // Operand stack each nested call beyond `call_limit` can add; 0 when no
+    // function is recursive
+    size_t stackPerCall() const;
+    bool isRecursive() const;
+    const std::vector<Function>& functions() const; // parallel to cfg.functions()
+
+private:
+    bool analyse(const std::vector<Instruction>& instructions, const ControlFlowGraph& cfg, size_t f);
+    size_t need(const std::vector<Instruction>& instructions, const ControlFlowGraph& cfg, size_t f);
+
+    std::vector<int> heights;
+    std::vector<Function> function_info;
+    std::vector<int> need_of;   // per function: stack needed by it and its callees, -1 while unknown
+    std::vector<int> calls_of;  // per function: deepest nesting below it
+    std::vector<bool> visiting; // need() recursion guard
+    size_t max_stack;
+    size_t max_call_depth;
+    size_t stack_per_call;
+    bool recursive;
+};
+
+#endif
@@ -0,0 +1,349 @@
+#include "constant_folding.hpp"
+#include "bytecode_verifier.hpp"
+#include "control_flow.hpp"
+#include <climits>
+#include <cstdint>
+#include <stdexcept>
+
+namespace {
+
+struct Value {
+    bool known;
+    int value;
+    bool pending; // known and not pushed yet; only a run at the top of the stack is
+};
+
+struct State {
+    bool reached;
+    std::vector<Value> stack; // from the function's entry height
+    std::vector<Value> locals;
+};
+
+const Value kUnknown = {false, 0, false};
+
+// Result of a foldable binary op, false where it would trap or is not one
+bool foldBinary(const std::string& name, int a, int b, int& result) {
+    int64_t wide = 0;
+    if (name == "IADD") {
+        wide = static_cast<int64_t>(a) + b;
+    } else if (name == "ISUB") {
+        wide = static_cast<int64_t>(a) - b;
+    } else if (name == "IMUL") {
+        wide = static_cast<int64_t>(a) * b;
+    } else if (name == "IDIV") {
+        if (b == 0 || (a == INT_MIN && b == -1)) return false;
+        wide = a / b;
+    } else if (name == "icmp_eq" || name == "ICMP") {
+        wide = (a == b) ? 1 : 0;
+    } else if (name == "icmp_lt") {
+        wide = (a < b) ? 1 : 0;
+    } else if (name == "icmp_gt") {
+        wide = (a > b) ? 1 : 0;
+    } else {
+        return false;
+    }
+    if (wide < INT_MIN || wide > INT_MAX) return false;
+    result = static_cast<int>(wide);
+    return true;
+}
+
+bool isBinary(const std::string& name) {
+    return name == "IADD" || name == "ISUB" || name == "IMUL" || name == "IDIV" ||
+           name == "icmp_eq" || name == "icmp_lt" || name == "icmp_gt" || name == "ICMP";
+}
+
+bool isConditional(const std::string& name) {
+    return name == "jmp_if_false" || name == "JMP_IF_ZERO" || name == "JNZ";
+}
+
+class Folder {
+public:
+    Folder(const std::vector<Instruction>& instructions, const ControlFlowGraph& cfg, const BytecodeVerifier& verifier)
+        : stats{0, 0, 0, 0, 0}, instructions(instructions), cfg(cfg), verifier(verifier),
+          in(cfg.blocks().size(), State{false, {}, {}}), out(nullptr) {}
+
+    std::vector<Instruction> run(std::vector<SymbolEntry>& symbols) {
+        std::vector<Instruction> result;
+        std::vector<size_t> new_index(cfg.size() + 1, 0);
+        out = &result;
+        for (size_t f = 0; f < cfg.functions().size(); ++f) {
+            const ControlFlowGraph::Function& fn = cfg.functions()[f];
+            if (!verifier.functions()[f].reachable) {
+                for (size_t i = fn.first; i < fn.end; ++i) {
+                    new_index[i] = result.size();
+                    emit(i, instructions[i]);
+                }
+                continue;
+            }
+            analyse(f);
+            for (size_t b = fn.first_block; b < fn.end_block; ++b) {
+                const ControlFlowGraph::Block& block = cfg.blocks()[b];
+                for (size_t i = block.first; i < block.end; ++i) new_index[i] = result.size();
+                if (!in[b].reached) continue;
+                State state = in[b];
+                size_t taken = kNoBlock;
+                size_t fall = kNoBlock;
+                walk(b, state, taken, fall, &new_index);
+            }
+        }
+        new_index[cfg.size()] = result.size();
+
+        // A JMP to the instruction after it, left where a branch was
+        // resolved or the blocks between went away, is dropped
+        std::vector<bool> keep(result.size(), true);
+        for (const auto& fix : fixups) {
+            if (result[fix.first].name == "JMP" && new_index[fix.second] == fix.first + 1) keep[fix.first] = false;
+        }
+        std::vector<size_t> kept_before(result.size() + 1, 0);
+        for (size_t k = 0; k < result.size(); ++k) kept_before[k + 1] = kept_before[k] + (keep[k] ? 1 : 0);
+
+        // Byte offsets of the new layout, then every jump and INVOKE and
+        // TEXT symbol moves to where its old target went
+        std::vector<Instruction> compacted;
+        std::vector<uint32_t> offsets(1, 0);
+        for (size_t k = 0; k < result.size(); ++k) {
+            if (!keep[k]) continue;
+            offsets.push_back(offsets.back() + encodedSize(result[k].name));
+            compacted.push_back(result[k]);
+        }
+        for (const auto& fix : fixups) {
+            if (!keep[fix.first]) continue;
+            compacted[kept_before[fix.first]].operands[0] = static_cast<int>(offsets[kept_before[new_index[fix.second]]]);
+        }
+        for (SymbolEntry& sym : symbols) {
+            if (!sym.defined || sym.type != 0) continue;
+            int index = cfg.indexAtOffset(sym.address);
+            if (index >= 0) sym.address = offsets[kept_before[new_index[index]]];
+        }
+        out = nullptr;
+        return compacted;
+    }
+
+    FoldStats stats;
+
+private:
+    static const size_t kNoBlock = static_cast<size_t>(-1);
+
+    // Block entry states of function `f`, following only the edges a
+    // known branch condition allows
+    void analyse(size_t f) {
+        const ControlFlowGraph::Function& fn = cfg.functions()[f];
+        int max_local = verifier.functions()[f].max_local;
+        State& entry = in[fn.first_block];
+        entry.reached = true;
+        entry.locals.assign(static_cast<size_t>(max_local + 1), kUnknown);
+
+        std::vector<size_t> work{fn.first_block};
+        std::vector<bool> queued(cfg.blocks().size(), false);
+        queued[fn.first_block] = true;
+        std::vector<Instruction>* saved = out;
+        out = nullptr;
+        while (!work.empty()) {
+            size_t b = work.back();
+            work.pop_back();
+            queued[b] = false;
+            State state = in[b];
+            size_t taken = kNoBlock;
+            size_t fall = kNoBlock;
+            walk(b, state, taken, fall, nullptr);
+            for (size_t succ : {taken, fall}) {
+                if (succ != kNoBlock && merge(in[succ], state) && !queued[succ]) {
+                    queued[succ] = true;
+                    work.push_back(succ);
+                }
+            }
+        }
+        out = saved;
+    }
+
+    // Meets `from` into `into`; true when `into` changed
+    static bool merge(State& into, const State& from) {
+        if (!into.reached) {
+            into = from;
+            for (Value& v : into.stack) v.pending = false;
+            return true;
+        }
+        if (into.stack.size() != from.stack.size()) throw std::runtime_error("Constant folding: stack heights disagree");
+        bool changed = false;
+        auto meet = [&changed](Value& a, const Value& b) {
+            if (a.known && (!b.known || a.value != b.value)) {
+                a = kUnknown;
+                changed = true;
+            }
+        };
+        for (size_t k = 0; k < into.stack.size(); ++k) meet(into.stack[k], from.stack[k]);
+        for (size_t k = 0; k < into.locals.size(); ++k) meet(into.locals[k], from.locals[k]);
+        return changed;
+    }
+
+    void emit(size_t from, const Instruction& instr) {
+        if (out == nullptr) return;
+        if (isBranch(instr.name) || instr.name == "INVOKE") {
+            fixups.push_back({out->size(), static_cast<size_t>(cfg.targetOf(from))});
+        }
+        out->push_back(instr);
+    }
+
+    void flush(std::vector<Value>& stack) {
+        for (Value& v : stack) {
+            if (!v.pending) continue;
+            if (out != nullptr) out->push_back(Instruction{"ICONST", {v.value}});
+            v.pending = false;
+        }
+    }
+
+    void count(size_t& counter) {
+        if (out != nullptr) ++counter;
+    }
+
+    // Runs block `b` from `state`. Sets `taken` and `fall` to the blocks
+    // control can go on to (kNoBlock for none) and, when emitting, writes
+    // the block's new code.
+    void walk(size_t b, State& state, size_t& taken, size_t& fall, std::vector<size_t>* new_index) {
+        const ControlFlowGraph::Block& block = cfg.blocks()[b];
+        std::vector<Value>& stack = state.stack;
+        taken = kNoBlock;
+        fall = (b + 1 < cfg.blocks().size() && cfg.blocks()[b + 1].function == block.function) ? b + 1 : kNoBlock;
+        auto blockAt = [this](int index) {
+            return static_cast<size_t>(index) < cfg.size() ? cfg.blockOf(static_cast<size_t>(index)) : kNoBlock;
+        };
+
+        for (size_t i = block.first; i < block.end; ++i) {
+            if (new_index != nullptr) (*new_index)[i] = out->size();
+            const Instruction& instr = instructions[i];
+            const std::string& name = instr.name;
+            if (isLabelPseudo(name)) {
+                emit(i, instr);
+                continue;
+            }
+
+            if (name == "ICONST") {
+                stack.push_back({true, instr.operands[0], true});
+            } else if (name == "ILOAD" || name == "LOAD") {
+                const Value& local = state.locals[instr.operands[0]];
+                if (local.known) {
+                    stack.push_back({true, local.value, true});
+                    count(stats.propagated);
+                } else {
+                    flush(stack);
+                    emit(i, instr);
+                    stack.push_back(kUnknown);
+                }
+            } else if (name == "ISTORE" || name == "STORE") {
+                Value top = stack.back();
+                stack.pop_back();
+                if (top.pending && out != nullptr) out->push_back(Instruction{"ICONST", {top.value}});
+                emit(i, instr);
+                state.locals[instr.operands[0]] = {top.known, top.value, false};
+            } else if (name == "POP") {
+                Value top = stack.back();
+                stack.pop_back();
+                if (!top.pending) emit(i, instr);
+            } else if (name == "DUP") {
+                Value top = stack.back();
+                if (!top.pending) emit(i, instr);
+                stack.push_back(top);
+            } else if (isBinary(name)) {
+                Value rhs = stack.back();
+                Value lhs = stack[stack.size() - 2];
+                int result = 0;
+                bool known = lhs.known && rhs.known && foldBinary(name, lhs.value, rhs.value, result);
+                if (known && lhs.pending && rhs.pending) {
+                    count(stats.folded);
+                } else {
+                    flush(stack);
+                    emit(i, instr);
+                }
+                stack.pop_back();
+                stack.back() = {known, result, known && lhs.pending && rhs.pending};
+            } else if (isConditional(name)) {
+                Value cond = stack.back();
+                stack.pop_back();
+                if (cond.known) {
+                    count(stats.branches);
+                    if (!cond.pending) emit(i, Instruction{"POP", {}});
+                    bool jumps = (name == "JNZ") ? cond.value != 0 : cond.value == 0;
+                    if (jumps) {
+                        flush(stack);
+                        emit(i, Instruction{"JMP", {0}});
+                        taken = blockAt(cfg.targetOf(i));
+                        fall = kNoBlock;
+                    }
+                } else {
+                    flush(stack);
+                    emit(i, instr);
+                    taken = blockAt(cfg.targetOf(i));
+                }
+            } else if (name == "JMP") {
+                flush(stack);
+                emit(i, instr);
+                taken = blockAt(cfg.targetOf(i));
+                fall = kNoBlock;
+            } else if (name == "RET") {
+                flush(stack);
+                emit(i, instr);
+                fall = kNoBlock;
+            } else if (name == "INVOKE") {
+                flush(stack);
+                emit(i, instr);
+                stack.resize(stack.size() - instr.operands[1]);
+                int returned = verifier.functions()[cfg.functionOf(cfg.targetOf(i))].return_height;
+                if (returned < 0) {
+                    // The callee never returns, so nothing after this runs
+                    fall = kNoBlock;
+                    break;
+                }
+                stack.resize(stack.size() + returned, kUnknown);
+            } else {
+                int pops = 0;
+                int pushes = 0;
+                stackEffect(name, pops, pushes);
+                flush(stack);
+                emit(i, instr);
+                stack.resize(stack.size() - pops);
+                stack.resize(stack.size() + pushes, kUnknown);
+            }
+        }
+        flush(stack); // nothing is left pending after a JMP or RET
+    }
+
+    const std::vector<Instruction>& instructions;
+    const ControlFlowGraph& cfg;
+    const BytecodeVerifier& verifier;
+    std::vector<State> in; // per block
+    std::vector<Instruction>* out; // null while analysing
+    std::vector<std::pair<size_t, size_t>> fixups; // (new index, old target index)
+};
+
+size_t countReal(const std::vector<Instruction>& instructions) {
+    size_t count = 0;
+    for (const Instruction& instr : instructions) {
+        if (!isLabelPseudo(instr.name)) ++count;
+    }
+    return count;
+}
+
+} // namespace
+
+std::vector<Instruction> foldConstants(const std::vector<Instruction>& instructions,
+                                       std::vector<SymbolEntry>& symbols, FoldStats* stats) {
+    if (stats != nullptr) *stats = FoldStats{0, 0, 0, countReal(instructions), countReal(instructions)};
+    ControlFlowGraph cfg;
+    BytecodeVerifier verifier;
+    try {
+        cfg = ControlFlowGraph(instructions);
+        verifier = BytecodeVerifier(instructions, cfg, 0);
+    } catch (const std::runtime_error&) {
+        return instructions;
+    }
+    if (cfg.size() == 0) return instructions;
+
+    Folder folder(instructions, cfg, verifier);
+    std::vector<Instruction> result = folder.run(symbols);
+    if (stats != nullptr) {
+        *stats = folder.stats;
+        stats->before = countReal(instructions);
+        stats->after = countReal(result);
+    }
+    return result;
+}
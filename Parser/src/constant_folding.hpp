@@ -0,0 +1,36 @@
+#ifndef CONSTANT_FOLDING_HPP
+#define CONSTANT_FOLDING_HPP
+
+#include "parser.hpp"
+#include "symbol_table.hpp"
+#include <cstddef>
+#include <vector>
+
+struct FoldStats {
+    size_t folded;     // arithmetic and compares computed here
+    size_t propagated; // ILOADs of a local known to hold a constant
+    size_t branches;   // jmp_if_false / JNZ on a known value
+    size_t before;     // instructions in and out, label pseudo-instructions excluded
+    size_t after;
+};
+
+// IR pass run on main.cpp's instruction list before simulation and code
+// generation. Within each function it tracks which operand stack entries
+// and locals hold known constants, block by block to a fixed point, and
+// rewrites the code so that:
+// - arithmetic and compares on constants become one ICONST,
+// - an ILOAD of a local holding a constant becomes that ICONST,
+// - a conditional branch on a known value becomes a JMP or nothing, and
+//   blocks no longer reached are dropped.
+// Constants are only materialized where an instruction that stays needs
+// them. Folding never hides a trap: IADD/ISUB/IMUL that would overflow
+// (the MIPS code traps there) and IDIV by zero are left alone.
+//
+// Jump and INVOKE offsets are recomputed for the new layout, and the
+// addresses of TEXT symbols in `symbols` are moved to match. Functions
+// nothing calls are copied unchanged. A program the BytecodeVerifier
+// rejects is returned unchanged, so loading it reports the usual error.
+std::vector<Instruction> foldConstants(const std::vector<Instruction>& instructions,
+                                       std::vector<SymbolEntry>& symbols, FoldStats* stats = nullptr);
+
+#endif
@@ -0,0 +1,142 @@
+#include "control_flow.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+bool isLabelPseudo(const std::string& name) {
+    return name.empty() || name[0] == '.' || name.back() == ':';
+}
+
+bool isBranch(const std::string& name) {
+    return name == "JMP" || name == "jmp_if_false" || name == "JMP_IF_ZERO" || name == "JNZ";
+}
+
+uint32_t encodedSize(const std::string& name) {
+    if (isLabelPseudo(name)) return 0;
+    if (name == "ICONST" || name == "ILOAD" || name == "ISTORE" || name == "LOAD" || name == "STORE" || isBranch(name)) {
+        return 5;
+    }
+    if (name == "INVOKE") return 6;
+    return 1;
+}
+
+ControlFlowGraph::ControlFlowGraph() {}
+
+ControlFlowGraph::ControlFlowGraph(const std::vector<Instruction>& instructions) {
+    const size_t n = instructions.size();
+    offsets.resize(n);
+    uint32_t offset = 0;
+    for (size_t i = 0; i < n; ++i) {
+        offsets[i] = offset;
+        offset += encodedSize(instructions[i].name);
+    }
+    index_at.assign(offset + 1, -1);
+    index_at[offset] = static_cast<int32_t>(n);
+    for (size_t i = n; i-- > 0;) {
+        index_at[offsets[i]] = static_cast<int32_t>(i); // the first entry at an offset wins
+    }
+
+    // A run of label pseudo-instructions at one offset starts one function
+    std::vector<bool> function_start(n, false);
+    std::vector<bool> leader(n, false);
+    if (n > 0) function_start[0] = true;
+    for (size_t i = 1; i < n; ++i) {
+        if (isLabelPseudo(instructions[i].name) && !isLabelPseudo(instructions[i - 1].name)) function_start[i] = true;
+    }
+
+    targets.assign(n, -1);
+    for (size_t i = 0; i < n; ++i) {
+        const Instruction& instr = instructions[i];
+        bool invoke = (instr.name == "INVOKE");
+        if (!invoke && !isBranch(instr.name)) {
+            if (instr.name == "RET" && i + 1 < n) leader[i + 1] = true;
+            continue;
+        }
+        if (instr.operands.empty()) {
+            throw std::runtime_error("Missing operand for " + instr.name);
+        }
+        int target = instr.operands[0];
+        if (target < 0 || static_cast<size_t>(target) >= index_at.size() || index_at[target] < 0) {
+            throw std::runtime_error("Branch target " + std::to_string(target) + " is not an instruction boundary");
+        }
+        targets[i] = index_at[target];
+        if (static_cast<size_t>(targets[i]) < n) {
+            (invoke ? function_start : leader)[targets[i]] = true;
+        }
+        if (!invoke && i + 1 < n) leader[i + 1] = true;
+    }
+
+    block_of.assign(n, 0);
+    for (size_t i = 0; i < n; ++i) {
+        if (function_start[i]) {
+            if (!function_list.empty()) {
+                function_list.back().end = i;
+                function_list.back().end_block = block_list.size();
+            }
+            function_list.push_back(Function{i, n, block_list.size(), 0, false});
+        }
+        if (function_start[i] || leader[i]) {
+            if (!block_list.empty()) block_list.back().end = i;
+            block_list.push_back(Block{i, n, function_list.size() - 1, {}, {}});
+        }
+        if (instructions[i].name == "main:" || instructions[i].name == "kik:") function_list.back().is_main = true;
+        block_of[i] = static_cast<uint32_t>(block_list.size() - 1);
+    }
+    if (!function_list.empty()) function_list.back().end_block = block_list.size();
+
+    auto link = [this](size_t from, size_t to_index) {
+        if (to_index >= block_of.size()) return; // leaves through the end of the code
+        size_t to = block_of[to_index];
+        if (block_list[to].function != block_list[from].function) return;
+        std::vector<size_t>& out = block_list[from].successors;
+        if (std::find(out.begin(), out.end(), to) != out.end()) return;
+        out.push_back(to);
+        block_list[to].predecessors.push_back(from);
+    };
+    for (size_t b = 0; b < block_list.size(); ++b) {
+        size_t last = block_list[b].end - 1;
+        const std::string& name = instructions[last].name;
+        if (name == "RET" || name == "HALT") continue;
+        if (isBranch(name)) link(b, static_cast<size_t>(targets[last]));
+        if (name != "JMP") link(b, block_list[b].end);
+    }
+}
+
+size_t ControlFlowGraph::size() const {
+    return offsets.size();
+}
+
+uint32_t ControlFlowGraph::codeBytes() const {
+    return index_at.empty() ? 0 : static_cast<uint32_t>(index_at.size() - 1);
+}
+
+int ControlFlowGraph::indexAtOffset(uint32_t offset) const {
+    return offset < index_at.size() ? index_at[offset] : -1;
+}
+
+uint32_t ControlFlowGraph::offsetOf(size_t index) const {
+    return index < offsets.size() ? offsets[index] : codeBytes();
+}
+
+int ControlFlowGraph::targetOf(size_t index) const {
+    return targets[index];
+}
+
+bool ControlFlowGraph::isLeader(size_t index) const {
+    return block_list[block_of[index]].first == index;
+}
+
+size_t ControlFlowGraph::blockOf(size_t index) const {
+    return block_of[index];
+}
+
+size_t ControlFlowGraph::functionOf(size_t index) const {
+    return block_list[block_of[index]].function;
+}
+
+const std::vector<ControlFlowGraph::Block>& ControlFlowGraph::blocks() const {
+    return block_list;
+}
+
+const std::vector<ControlFlowGraph::Function>& ControlFlowGraph::functions() const {
+    return function_list;
+}
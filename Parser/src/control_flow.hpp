@@ -0,0 +1,77 @@
+#ifndef CONTROL_FLOW_HPP
+#define CONTROL_FLOW_HPP
+
+#include "parser.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Byte size of an instruction in the .o code section, matching what
+// parser.cpp reads: 5 with a 4-byte operand, 6 for INVOKE (address and
+// argument count), 1 otherwise. The label pseudo-instructions main.cpp
+// inserts ("main:", ".global") take no space.
+uint32_t encodedSize(const std::string& name);
+bool isLabelPseudo(const std::string& name);
+// JMP, jmp_if_false and JNZ; their operand is a byte offset
+bool isBranch(const std::string& name);
+
+// Control-flow analysis of an instruction list as main.cpp prepares it
+// (parser output with label pseudo-instructions), built once at load time.
+// Indices are positions in that list. Jump and INVOKE operands are byte
+// offsets; every offset resolves to the first entry placed there, which is
+// the label pseudo-instruction when the offset starts a function.
+//
+// Functions begin at index 0, at each label pseudo-instruction and at each
+// INVOKE target, and run to the next such start, as the generator lays them
+// out. Blocks begin at function starts, at branch targets and after
+// branches and RET; edges stay within a function (INVOKE does not end a
+// block).
+class ControlFlowGraph {
+public:
+    struct Block {
+        size_t first; // leader
+        size_t end;   // one past the last instruction
+        size_t function;
+        std::vector<size_t> successors;   // block numbers
+        std::vector<size_t> predecessors;
+    };
+
+    struct Function {
+        size_t first; // instruction index of the start
+        size_t end;
+        size_t first_block;
+        size_t end_block;
+        bool is_main; // starts at the "main:" (or "kik:") pseudo-instruction
+    };
+
+    ControlFlowGraph();
+    // Throws std::runtime_error when a target is not an instruction boundary
+    explicit ControlFlowGraph(const std::vector<Instruction>& instructions);
+
+    size_t size() const;       // instructions analysed
+    uint32_t codeBytes() const;
+
+    // Index of the first entry at byte `offset`, size() for the end of the
+    // code, -1 when no instruction starts there
+    int indexAtOffset(uint32_t offset) const;
+    uint32_t offsetOf(size_t index) const;
+    // Resolved jump or INVOKE target of `index`; -1 for other instructions
+    int targetOf(size_t index) const;
+
+    bool isLeader(size_t index) const;
+    size_t blockOf(size_t index) const;
+    size_t functionOf(size_t index) const;
+    const std::vector<Block>& blocks() const;
+    const std::vector<Function>& functions() const;
+
+private:
+    std::vector<uint32_t> offsets;      // per instruction
+    std::vector<int32_t> index_at;      // per byte offset, plus one for the end
+    std::vector<int32_t> targets;       // per instruction
+    std::vector<uint32_t> block_of;     // per instruction
+    std::vector<Block> block_list;
+    std::vector<Function> function_list;
+};
+
+#endif
@@ -0,0 +1,213 @@
+#include "inliner.hpp"
+#include "bytecode_verifier.hpp"
+#include "control_flow.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+const size_t kInlineSize = 12;
+const size_t kInlineSingleSite = 40;
+// Locals a caller may end up with, which keeps its frame small
+const int kMaxFrameLocals = 32;
+const size_t kMinBudget = 64;
+
+const size_t kOriginal = static_cast<size_t>(-1);
+
+bool isLocalAccess(const std::string& name) {
+    return name == "ILOAD" || name == "LOAD" || name == "ISTORE" || name == "STORE";
+}
+
+size_t countReal(const std::vector<Instruction>& instructions) {
+    size_t count = 0;
+    for (const Instruction& instr : instructions) {
+        if (!isLabelPseudo(instr.name)) ++count;
+    }
+    return count;
+}
+
+std::string functionName(const ControlFlowGraph& cfg, size_t f, const std::vector<SymbolEntry>& symbols) {
+    uint32_t offset = cfg.offsetOf(cfg.functions()[f].first);
+    for (const SymbolEntry& sym : symbols) {
+        if (sym.defined && sym.type == 0 && sym.address == offset) return sym.name;
+    }
+    return cfg.functions()[f].is_main ? "main" : "L" + std::to_string(offset);
+}
+
+// Whether function `f` can be copied into a caller at all; `reason` says
+// why not
+struct Callee {
+    bool inlinable;
+    std::string reason;
+    size_t size; // instructions, RETs excluded
+    size_t sites;
+};
+
+Callee examine(const std::vector<Instruction>& instructions, const ControlFlowGraph& cfg,
+               const BytecodeVerifier& verifier, size_t f) {
+    const ControlFlowGraph::Function& fn = cfg.functions()[f];
+    Callee callee{true, "", 0, 0};
+    for (size_t i = fn.first; i < fn.end; ++i) {
+        const std::string& name = instructions[i].name;
+        if (isLabelPseudo(name)) continue;
+        if (name != "RET") ++callee.size;
+        if (isBranch(name)) {
+            size_t target = static_cast<size_t>(cfg.targetOf(i));
+            if (target < fn.first || target >= fn.end) callee = Callee{false, "jumps out of the function", callee.size, 0};
+        }
+    }
+    if (fn.is_main) {
+        callee = Callee{false, "callee is main", callee.size, 0};
+    } else if (verifier.functions()[f].return_height < 0) {
+        callee = Callee{false, "callee never returns", callee.size, 0};
+    }
+    return callee;
+}
+
+} // namespace
+
+std::vector<Instruction> inlineCalls(const std::vector<Instruction>& instructions,
+                                     std::vector<SymbolEntry>& symbols, InlineStats* stats) {
+    if (stats != nullptr) *stats = InlineStats{{}, 0, countReal(instructions), countReal(instructions)};
+    ControlFlowGraph cfg;
+    BytecodeVerifier verifier;
+    try {
+        cfg = ControlFlowGraph(instructions);
+        verifier = BytecodeVerifier(instructions, cfg, 0);
+    } catch (const std::runtime_error&) {
+        return instructions;
+    }
+    const size_t n = cfg.size();
+    if (n == 0) return instructions;
+
+    std::vector<Callee> callees;
+    for (size_t f = 0; f < cfg.functions().size(); ++f) callees.push_back(examine(instructions, cfg, verifier, f));
+
+    // Call sites in reachable code
+    std::vector<size_t> sites;
+    for (size_t i = 0; i < n; ++i) {
+        if (instructions[i].name != "INVOKE" || !verifier.functions()[cfg.functionOf(i)].reachable) continue;
+        sites.push_back(i);
+        ++callees[cfg.functionOf(static_cast<size_t>(cfg.targetOf(i)))].sites;
+    }
+
+    // Smaller callees get the budget first
+    std::vector<size_t> order(sites.size());
+    for (size_t s = 0; s < order.size(); ++s) order[s] = s;
+    auto calleeOf = [&](size_t s) { return cfg.functionOf(static_cast<size_t>(cfg.targetOf(sites[s]))); };
+    std::stable_sort(order.begin(), order.end(),
+                     [&](size_t a, size_t b) { return callees[calleeOf(a)].size < callees[calleeOf(b)].size; });
+
+    std::vector<int> base(cfg.functions().size()); // first renamed local, per caller
+    for (size_t f = 0; f < base.size(); ++f) base[f] = verifier.functions()[f].max_local + 1;
+    const size_t budget = std::max(kMinBudget, countReal(instructions) / 2);
+    size_t used = 0;
+    std::vector<InlineSite> report(sites.size());
+    std::vector<bool> inline_at(n, false);
+    for (size_t s : order) {
+        size_t i = sites[s];
+        size_t caller = cfg.functionOf(i);
+        size_t f = calleeOf(s);
+        const Callee& callee = callees[f];
+        int locals = verifier.functions()[f].max_local + 1;
+        int args = instructions[i].operands[1];
+        size_t growth = callee.size + static_cast<size_t>(args) - 1; // the INVOKE goes away
+        std::string reason = callee.reason;
+        if (callee.inlinable) {
+            if (f == caller) {
+                reason = "recursive";
+            } else if (callee.size > (callee.sites == 1 ? kInlineSingleSite : kInlineSize)) {
+                reason = "too large for " + std::to_string(callee.sites) + " call site" + (callee.sites == 1 ? "" : "s");
+            } else if (base[caller] + locals > kMaxFrameLocals) {
+                reason = "caller frame full";
+            } else if (used + growth > budget) {
+                reason = "over budget";
+            }
+        }
+        if (reason.empty()) {
+            inline_at[i] = true;
+            used += growth;
+        }
+        report[s] = InlineSite{cfg.offsetOf(i), functionName(cfg, caller, symbols), functionName(cfg, f, symbols),
+                               callee.size, reason.empty(), reason};
+    }
+
+    // New code. Fixups are (new index, copy, old target index), the copy
+    // kOriginal for targets outside every copy.
+    struct Fixup {
+        size_t at;
+        size_t copy;
+        size_t target;
+    };
+    std::vector<Instruction> result;
+    std::vector<size_t> new_index(n + 1, 0);
+    std::vector<Fixup> fixups;
+    std::vector<std::vector<size_t>> copies; // per copy: new index of each callee instruction
+    std::vector<size_t> copy_first;          // per copy: the callee's first instruction
+    for (size_t i = 0; i < n; ++i) {
+        new_index[i] = result.size();
+        const Instruction& instr = instructions[i];
+        if (!inline_at[i]) {
+            if (isBranch(instr.name) || instr.name == "INVOKE") {
+                fixups.push_back({result.size(), kOriginal, static_cast<size_t>(cfg.targetOf(i))});
+            }
+            result.push_back(instr);
+            continue;
+        }
+
+        const ControlFlowGraph::Function& fn = cfg.functions()[cfg.functionOf(static_cast<size_t>(cfg.targetOf(i)))];
+        int first_local = base[cfg.functionOf(i)];
+        // Arguments: the last pushed goes in the highest local
+        for (int a = instr.operands[1] - 1; a >= 0; --a) result.push_back(Instruction{"ISTORE", {first_local + a}});
+        size_t last = fn.end;
+        for (size_t j = fn.first; j < fn.end; ++j) {
+            if (!isLabelPseudo(instructions[j].name)) last = j;
+        }
+        size_t copy = copies.size();
+        copies.push_back(std::vector<size_t>(fn.end - fn.first));
+        copy_first.push_back(fn.first);
+        for (size_t j = fn.first; j < fn.end; ++j) {
+            copies[copy][j - fn.first] = result.size();
+            Instruction body = instructions[j];
+            if (isLabelPseudo(body.name)) continue;
+            if (isLocalAccess(body.name)) body.operands[0] += first_local;
+            if (body.name == "RET") {
+                if (j == last) continue; // falls through to the code after the call
+                body = Instruction{"JMP", {0}};
+                fixups.push_back({result.size(), kOriginal, i + 1});
+            } else if (isBranch(body.name)) {
+                fixups.push_back({result.size(), copy, static_cast<size_t>(cfg.targetOf(j))});
+            } else if (body.name == "INVOKE") {
+                fixups.push_back({result.size(), kOriginal, static_cast<size_t>(cfg.targetOf(j))});
+            }
+            result.push_back(body);
+        }
+    }
+    new_index[n] = result.size();
+
+    std::vector<uint32_t> offsets(1, 0);
+    for (const Instruction& instr : result) offsets.push_back(offsets.back() + encodedSize(instr.name));
+    for (const Fixup& fix : fixups) {
+        size_t target = fix.copy == kOriginal ? new_index[fix.target] : copies[fix.copy][fix.target - copy_first[fix.copy]];
+        result[fix.at].operands[0] = static_cast<int>(offsets[target]);
+    }
+
+    // The result must load as the input did
+    try {
+        ControlFlowGraph check(result);
+        BytecodeVerifier(result, check, 0);
+    } catch (const std::runtime_error&) {
+        return instructions;
+    }
+    for (SymbolEntry& sym : symbols) {
+        if (!sym.defined || sym.type != 0) continue;
+        int index = cfg.indexAtOffset(sym.address);
+        if (index >= 0) sym.address = offsets[new_index[index]];
+    }
+    if (stats != nullptr) {
+        stats->sites = report;
+        stats->inlined = static_cast<size_t>(std::count(inline_at.begin(), inline_at.end(), true));
+        stats->after = countReal(result);
+    }
+    return result;
+}
@@ -0,0 +1,50 @@
+#ifndef INLINER_HPP
+#define INLINER_HPP
+
+#include "parser.hpp"
+#include "symbol_table.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One INVOKE and what the inliner did with it
+struct InlineSite {
+    uint32_t offset;    // of the INVOKE, before inlining
+    std::string caller; // TEXT symbol at the function's start, or L<offset>
+    std::string callee;
+    size_t size;        // callee instructions, RETs and label pseudo-instructions excluded
+    bool inlined;
+    std::string reason; // why not, empty when inlined
+};
+
+struct InlineStats {
+    std::vector<InlineSite> sites; // in code order
+    size_t inlined;
+    size_t before; // instructions in and out, label pseudo-instructions excluded
+    size_t after;
+};
+
+// IR pass run on main.cpp's instruction list before constant folding.
+// Replaces an INVOKE of a small function by a copy of its body: the
+// arguments are stored into locals of the caller above the ones it uses
+// (the callee's locals, renamed), branches inside the copy go to the copy,
+// and RET becomes a JMP past it (nothing for a RET at the end). The
+// callee's own INVOKEs stay calls. All the copies in one caller share the
+// same renamed locals, as one finishes before the next starts.
+//
+// A callee is inlined when it is at most 12 instructions, or 40 when it
+// has only one call site, and the caller keeps at most 32 locals, so its
+// frame stays small. Smaller callees go first until the growth budget (half
+// the program, at least 64 instructions) is used up. main, recursive calls
+// and functions that never return or jump out of themselves are not
+// inlined. The callee's own code stays, as symbols and other callers may
+// still name it.
+//
+// Jump and INVOKE offsets and TEXT symbol addresses follow the new layout,
+// as in foldConstants(). A program the BytecodeVerifier rejects is returned
+// unchanged.
+std::vector<Instruction> inlineCalls(const std::vector<Instruction>& instructions,
+                                     std::vector<SymbolEntry>& symbols, InlineStats* stats = nullptr);
+
+#endif
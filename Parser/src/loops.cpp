@@ -0,0 +1,121 @@
+#include "loops.hpp"
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+// Loops of one function; blocks are numbered from its first block
+void functionLoops(const ControlFlowGraph& cfg, const ControlFlowGraph::Function& fn, std::vector<NaturalLoop>& loops) {
+    const std::vector<ControlFlowGraph::Block>& blocks = cfg.blocks();
+    const size_t first = fn.first_block;
+    const size_t count = fn.end_block - fn.first_block;
+    if (count == 0) return;
+    auto inFunction = [&](size_t block) { return block >= first && block < fn.end_block; };
+
+    // Reverse postorder from the start
+    std::vector<int> rpo(count, -1);
+    std::vector<size_t> postorder;
+    std::vector<bool> seen(count, false);
+    std::vector<std::pair<size_t, size_t>> stack = {{0, 0}}; // block, next successor
+    seen[0] = true;
+    while (!stack.empty()) {
+        size_t b = stack.back().first;
+        const std::vector<size_t>& successors = blocks[first + b].successors;
+        if (stack.back().second < successors.size()) {
+            size_t s = successors[stack.back().second++];
+            if (inFunction(s) && !seen[s - first]) {
+                seen[s - first] = true;
+                stack.push_back({s - first, 0});
+            }
+            continue;
+        }
+        postorder.push_back(b);
+        stack.pop_back();
+    }
+    for (size_t i = 0; i < postorder.size(); ++i) rpo[postorder[i]] = static_cast<int>(postorder.size() - 1 - i);
+
+    // Immediate dominators (Cooper, Harvey and Kennedy, "A Simple, Fast
+    // Dominance Algorithm")
+    std::vector<int> idom(count, -1);
+    idom[0] = 0;
+    auto intersect = [&](int a, int b) {
+        while (a != b) {
+            while (rpo[a] > rpo[b]) a = idom[a];
+            while (rpo[b] > rpo[a]) b = idom[b];
+        }
+        return a;
+    };
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto it = postorder.rbegin(); it != postorder.rend(); ++it) {
+            size_t b = *it;
+            if (b == 0) continue;
+            int dom = -1;
+            for (size_t p : blocks[first + b].predecessors) {
+                if (!inFunction(p) || idom[p - first] < 0) continue;
+                int pred = static_cast<int>(p - first);
+                dom = dom < 0 ? pred : intersect(pred, dom);
+            }
+            if (dom != idom[b]) {
+                idom[b] = dom;
+                changed = true;
+            }
+        }
+    }
+    auto dominates = [&](size_t a, size_t b) {
+        for (;;) {
+            if (a == b) return true;
+            if (b == 0) return false;
+            b = static_cast<size_t>(idom[b]);
+        }
+    };
+
+    // One loop per header, grown backwards from its back edges
+    std::vector<NaturalLoop> found;
+    for (size_t h = 0; h < count; ++h) {
+        if (rpo[h] < 0) continue;
+        std::vector<bool> in_loop(count, false);
+        std::vector<size_t> work;
+        for (size_t p : blocks[first + h].predecessors) {
+            if (inFunction(p) && rpo[p - first] >= 0 && dominates(h, p - first) && !in_loop[p - first]) {
+                in_loop[p - first] = true;
+                work.push_back(p - first);
+            }
+        }
+        if (work.empty()) continue;
+        in_loop[h] = true;
+        while (!work.empty()) {
+            size_t b = work.back();
+            work.pop_back();
+            if (b == h) continue;
+            for (size_t p : blocks[first + b].predecessors) {
+                if (inFunction(p) && rpo[p - first] >= 0 && !in_loop[p - first]) {
+                    in_loop[p - first] = true;
+                    work.push_back(p - first);
+                }
+            }
+        }
+        NaturalLoop loop{first + h, {}, true};
+        for (size_t b = 0; b < count; ++b) {
+            if (in_loop[b]) loop.blocks.push_back(first + b);
+        }
+        found.push_back(loop);
+    }
+    for (NaturalLoop& loop : found) {
+        for (const NaturalLoop& other : found) {
+            if (other.header != loop.header && std::binary_search(loop.blocks.begin(), loop.blocks.end(), other.header)) {
+                loop.innermost = false;
+            }
+        }
+    }
+    loops.insert(loops.end(), found.begin(), found.end());
+}
+
+} // namespace
+
+std::vector<NaturalLoop> findLoops(const ControlFlowGraph& cfg) {
+    std::vector<NaturalLoop> loops;
+    for (const ControlFlowGraph::Function& fn : cfg.functions()) functionLoops(cfg, fn, loops);
+    return loops;
+}
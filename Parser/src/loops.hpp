@@ -0,0 +1,24 @@
+#ifndef LOOPS_HPP
+#define LOOPS_HPP
+
+#include "control_flow.hpp"
+#include <cstddef>
+#include <vector>
+
+// A natural loop of a ControlFlowGraph. A back edge goes from a block to
+// one that dominates it, the header; the loop is the header and every
+// block that reaches the edge's source without passing the header. Back
+// edges to the same header make one loop, so code can only enter it
+// through the header.
+struct NaturalLoop {
+    size_t header;              // block number
+    std::vector<size_t> blocks; // ascending, the header included
+    bool innermost;             // no other loop's header is among its blocks
+};
+
+// Loops of every function, ordered by header. Dominators are computed per
+// function over the blocks reachable from its start; blocks nothing
+// reaches belong to no loop.
+std::vector<NaturalLoop> findLoops(const ControlFlowGraph& cfg);
+
+#endif
@@ -3,36 +3,18 @@
 #include "symbol_table.hpp"
 #include "vm_simulator.hpp"
 #include "mips_assembler.hpp"
+#include "mips_simulator.hpp"
+#include "object_file.hpp"
+#include "peephole.hpp"
+#include "scheduler.hpp"
+#include "constant_folding.hpp"
+#include "inliner.hpp"
+#include <cstdlib>
 #include <iostream>
 #include <fstream>
 #include <string>
 #include <vector>
 #include <stdexcept>
-#include <map> // <-- ADDED for symbol map
-
-// Helper to convert two hex chars (e.g., '4', 'F') to a single byte (0x4F)
-uint8_t hex_to_byte(char hi, char lo) {
-    auto char_to_val = [](char c) -> uint8_t {
-        if (c >= '0' && c <= '9') return c - '0';
-        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
-        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
-        throw std::runtime_error("Invalid hex character in input file.");
-    };
-    return (char_to_val(hi) << 4) | char_to_val(lo);
-}
-
-// Helper function to read a 4-byte little-endian integer from a byte vector
-uint32_t read_le32(const std::vector<uint8_t>& bytes, size_t offset) {
-    if (offset + 4 > bytes.size()) {
-        throw std::runtime_error("Attempted to read beyond byte vector boundaries.");
-    }
-    uint32_t value = 0;
-    value |= static_cast<uint32_t>(bytes[offset + 0]);
-    value |= static_cast<uint32_t>(bytes[offset + 1]) << 8;
-    value |= static_cast<uint32_t>(bytes[offset + 2]) << 16;
-    value |= static_cast<uint32_t>(bytes[offset + 3]) << 24;
-    return value;
-}
 
 // Helper functions (unchanged)
 std::string getSymbolTypeString(uint8_t type) {
@@ -56,85 +38,107 @@ std::string getSymbolDefinedString(uint8_t defined) {
 
 int main(int argc, char* argv[]) {
     if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <input_file.txt>" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " <input_file.txt> [options]\n"
+                  << "  VM:     [--simulate] [--quiet] [--trace=FILE] [--profile=NAME] [--dispatch=switch|threaded|jit]\n"
+                  << "          [--no-fusion] [--max-call-depth=N] [--checkpoint=FILE@SYMBOL|OFFSET] [--restore=FILE]\n"
+                  << "  Passes: [--no-inline] [--no-fold] [--no-peephole] [--peephole=RULE,...] [--no-schedule]\n"
+                  << "  MIPS:   [--emit-asm] [--run-mips] [--mips-timing] [--icache=SIZE:LINE] [--dcache=SIZE:LINE]" << std::endl;
         return 1;
     }
 
-    std::vector<uint8_t> all_bytes;
-    try {
-        // ... (Hex file reading logic is correct and remains unchanged) ...
-        const std::string filename = argv[1];
-        std::ifstream file(filename); // Open as text
-        if (!file.is_open()) {
-            throw std::runtime_error("Cannot open text file: " + filename);
-        }
-
-        std::string line;
-        while (std::getline(file, line)) {
-            size_t comment_pos = line.find("//");
-            if (comment_pos != std::string::npos) {
-                line = line.substr(0, comment_pos);
-            }
-            char hi = 0;
-            for (char c : line) {
-                if (c >= '0' && c <= '9' || c >= 'a' && c <= 'f' || c >= 'A' && c <= 'F') {
-                    if (hi == 0) {
-                        hi = c;
-                    } else {
-                        all_bytes.push_back(hex_to_byte(hi, c));
-                        hi = 0;
-                    }
-                }
-            }
-            if (hi != 0) {
-                 throw std::runtime_error("Found an odd number of hex digits on a line.");
-            }
+    bool simulate = false;
+    bool run_mips = false; // run output.hex on MipsSimulator after assembling
+    bool mips_timing = false;
+    std::string icache_geometry = "4096:16";
+    std::string dcache_geometry = "4096:16";
+    bool fuse_superinstructions = true;
+    bool inline_calls = true;
+    bool fold_constants = true;
+    bool peephole = true;
+    std::string peephole_rules; // empty for all rules
+    bool schedule = true;
+    bool emit_asm = false; // write output.s as well as output.hex
+    VMSimulator::TraceMode trace_mode = VMSimulator::TraceMode::Listing;
+    std::string trace_filename;
+    std::string profile_name; // writes <NAME>.txt and <NAME>.folded
+    std::string checkpoint_filename;
+    std::string checkpoint_at; // TEXT symbol name or byte offset into the code section
+    std::string restore_filename;
+    VMSimulator::DispatchMode dispatch_mode = VMSimulator::DispatchMode::Threaded;
+    size_t max_call_depth = VMSimulator::kMaxCallDepth;
+    for (int i = 2; i < argc; ++i) {
+        const std::string option = argv[i];
+        if (option == "--simulate") {
+            simulate = true;
+        } else if (option == "--no-peephole") {
+            peephole = false;
+        } else if (option.rfind("--peephole=", 0) == 0) {
+            peephole_rules = option.substr(11);
+        } else if (option == "--no-schedule") {
+            schedule = false;
+        } else if (option == "--emit-asm") {
+            emit_asm = true;
+        } else if (option == "--run-mips") {
+            run_mips = true;
+        } else if (option == "--mips-timing") {
+            run_mips = mips_timing = true;
+        } else if (option.rfind("--icache=", 0) == 0) {
+            icache_geometry = option.substr(9);
+        } else if (option.rfind("--dcache=", 0) == 0) {
+            dcache_geometry = option.substr(9);
+        } else if (option == "--dispatch=switch") {
+            dispatch_mode = VMSimulator::DispatchMode::Switch;
+        } else if (option == "--dispatch=threaded") {
+            dispatch_mode = VMSimulator::DispatchMode::Threaded;
+        } else if (option == "--dispatch=jit") {
+            dispatch_mode = VMSimulator::DispatchMode::Jit;
+        } else if (option == "--no-fusion") {
+            fuse_superinstructions = false;
+        } else if (option.rfind("--max-call-depth=", 0) == 0) {
+            max_call_depth = std::strtoul(option.c_str() + 17, nullptr, 10);
+        } else if (option == "--no-inline") {
+            inline_calls = false;
+        } else if (option == "--no-fold") {
+            fold_constants = false;
+        } else if (option == "--quiet") {
+            trace_mode = VMSimulator::TraceMode::Quiet;
+        } else if (option.rfind("--trace=", 0) == 0) {
+            trace_mode = VMSimulator::TraceMode::Ring;
+            trace_filename = option.substr(8);
+        } else if (option.rfind("--profile=", 0) == 0) {
+            trace_mode = VMSimulator::TraceMode::Profile;
+            profile_name = option.substr(10);
+        } else if (option.rfind("--checkpoint=", 0) == 0 && option.find('@') != std::string::npos) {
+            size_t at = option.rfind('@');
+            checkpoint_filename = option.substr(13, at - 13);
+            checkpoint_at = option.substr(at + 1);
+        } else if (option.rfind("--restore=", 0) == 0) {
+            restore_filename = option.substr(10);
+        } else {
+            std::cerr << "Unknown option: " << option << std::endl;
+            return 1;
         }
+    }
 
+    std::vector<uint8_t> all_bytes;
+    try {
+        all_bytes = readHexBytes(argv[1]);
     } catch (const std::runtime_error& e) {
         std::cerr << "Error reading or parsing hex file: " << e.what() << std::endl;
         return 1;
     }
 
     try {
-        // ... (Header parsing logic remains unchanged) ...
-        if (all_bytes.size() < 20) {
-             throw std::runtime_error("File is too small to contain a valid header.");
-        }
-        uint32_t code_section_size = read_le32(all_bytes, 4);
-        uint32_t data_section_size = read_le32(all_bytes, 8);
-        uint32_t symbol_table_size = read_le32(all_bytes, 12);
+        ObjectFile object = parseObjectFile(all_bytes);
+        const std::vector<uint8_t>& code_bytes = object.code;
+        const std::vector<SymbolEntry>& symbol_table = object.symbols;
         std::cout << "--- Header Info ---" << std::endl;
-        std::cout << "Code Section Size: " << code_section_size << " bytes" << std::endl;
-        std::cout << "Data Section Size: " << data_section_size << " bytes" << std::endl;
-        std::cout << "Symbol Table Size: " << symbol_table_size << " bytes" << std::endl;
-        size_t current_offset = 20;
-        std::vector<uint8_t> code_bytes(all_bytes.begin() + current_offset, all_bytes.begin() + current_offset + code_section_size);
-        current_offset += code_section_size;
-        std::vector<uint8_t> data_bytes(all_bytes.begin() + current_offset, all_bytes.begin() + current_offset + data_section_size);
-        current_offset += data_section_size;
-        std::vector<uint8_t> symbol_table_bytes(all_bytes.begin() + current_offset, all_bytes.begin() + current_offset + symbol_table_size);
-        
-        // ... (Symbol table parsing logic remains unchanged) ...
-        std::cout << "\n--- Symbol Table Section (" << symbol_table_size << " bytes) ---" << std::endl;
-        std::vector<SymbolEntry> symbol_table;
-        size_t st_offset = 0;
-        uint32_t symbol_count = read_le32(symbol_table_bytes, st_offset);
-        st_offset += 4;
-        std::cout << "Symbol count: " << symbol_count << std::endl;
-        for (uint32_t i = 0; i < symbol_count; ++i) {
-            SymbolEntry entry;
-            uint32_t name_len = read_le32(symbol_table_bytes, st_offset);
-            st_offset += 4;
-            entry.name = std::string(reinterpret_cast<const char*>(symbol_table_bytes.data() + st_offset), name_len);
-            st_offset += name_len;
-            entry.type = symbol_table_bytes[st_offset++];
-            entry.binding = symbol_table_bytes[st_offset++];
-            entry.defined = symbol_table_bytes[st_offset++];
-            entry.address = read_le32(symbol_table_bytes, st_offset);
-            st_offset += 4;
-            symbol_table.push_back(entry);
-        }
+        std::cout << "Code Section Size: " << object.code.size() << " bytes" << std::endl;
+        std::cout << "Data Section Size: " << object.data.size() << " bytes" << std::endl;
+        std::cout << "Symbol Table Size: " << object.symbol_table_size << " bytes" << std::endl;
+
+        std::cout << "\n--- Symbol Table Section (" << object.symbol_table_size << " bytes) ---" << std::endl;
+        std::cout << "Symbol count: " << symbol_table.size() << std::endl;
         int symbol_index = 1;
         for (const auto& entry : symbol_table) {
             std::cout << "\n// Symbol " << symbol_index << ": \"" << entry.name << "\"" << std::endl;
@@ -154,53 +158,29 @@ int main(int argc, char* argv[]) {
         parser.printInstructions();
 
         
-        // --- NEW: Pre-processing Step (Your Idea) ---
-        
-        // 1. Create a map of symbols by their byte address
-        std::map<uint32_t, std::vector<SymbolEntry>> symbols_by_address;
-        for (const auto& sym : symbol_table) {
-            if (sym.defined) { // Only care about defined symbols
-                symbols_by_address[sym.address].push_back(sym);
-            }
-        }
+        // --- Pre-processing Step: label pseudo-instructions at symbol addresses ---
+        std::vector<Instruction> processed_instructions = insertSymbolLabels(instructions, symbol_table);
 
-        std::vector<Instruction> processed_instructions; // This is the new list
-        uint32_t current_bytes = 0;
-        
-        // 2. Loop through original instructions and insert labels
-        for (const auto& instr : instructions) {
-            
-            // Check if any symbols exist at the *current* byte offset
-            if (symbols_by_address.count(current_bytes)) {
-                for (const auto& sym : symbols_by_address[current_bytes]) {
-                    
-                    Instruction new_label_instr;
-                    if (sym.name == "kik" || sym.name == "main") {
-                        new_label_instr.name = "main:"; // As you specified
-                    } else if (sym.binding == 1) { // 1 = GLOBAL
-                        new_label_instr.name = ".global"; // As you specified
-                    }
-                    
-                    if (!new_label_instr.name.empty()) {
-                        processed_instructions.push_back(new_label_instr);
-                    }
-                }
-            }
-            
-            // 3. Add the actual instruction from the parser
-            processed_instructions.push_back(instr);
-            
-            // 4. Update the byte counter *after* processing
-            //    This logic MUST match parser.cpp
-            current_bytes++; // 1 for opcode
-            if (instr.name == "ICONST" || instr.name == "JMP" || instr.name == "ISTORE" || instr.name == "ILOAD" || instr.name == "jmp_if_false" || instr.name == "JNZ") {
-                current_bytes += 4;
-            } else if (instr.name == "INVOKE") {
-                current_bytes += 5; // 4-byte addr + 1-byte nArgs
+        // --- Optimization: inlining, then constant folding, before simulation and code generation ---
+        std::vector<SymbolEntry> code_symbols = symbol_table; // TEXT addresses follow the rewritten code
+        if (inline_calls) {
+            InlineStats inlined;
+            processed_instructions = inlineCalls(processed_instructions, code_symbols, &inlined);
+            std::cout << "\nInlining: " << inlined.inlined << " of " << inlined.sites.size() << " call sites inlined, "
+                      << inlined.before << " -> " << inlined.after << " instructions" << std::endl;
+            for (const InlineSite& site : inlined.sites) {
+                std::cout << "  INVOKE " << site.callee << " (" << site.size << " instructions) at " << site.offset
+                          << " in " << site.caller << ": " << (site.inlined ? "inlined" : "kept, " + site.reason) << std::endl;
             }
-            // (Add other opcodes from parser.cpp as needed)
         }
-        
+        if (fold_constants) {
+            FoldStats fold;
+            processed_instructions = foldConstants(processed_instructions, code_symbols, &fold);
+            std::cout << "\nConstant folding: " << fold.folded << " expressions folded, " << fold.propagated
+                      << " loads propagated, " << fold.branches << " branches resolved, " << fold.before
+                      << " -> " << fold.after << " instructions" << std::endl;
+        }
+
         std::cout << "\n--- Processed Instruction List ---" << std::endl;
         for (const auto& instr : processed_instructions) {
              std::cout << instr.name;
@@ -210,33 +190,128 @@ int main(int argc, char* argv[]) {
         std::cout<<"\n";
         // --- END: Pre-processing Step ---
 
-        
-        int stack_size_max = 0;
-        for(size_t i=0; i < processed_instructions.size(); i++) { // Use new list
-            if(processed_instructions[i].name == "ICONST") {
-                stack_size_max++;
-            }
-        }
 
         // --- Stage 2: Simulation ---
         // Pass the *new* processed list to the simulator
-        // VMSimulator simulator(processed_instructions); 
-        // // simulator.run(); // We can skip this if we just want to generate
+        if (simulate) {
+            VMSimulator simulator(processed_instructions, fuse_superinstructions);
+            simulator.setDispatchMode(dispatch_mode);
+            simulator.setMaxCallDepth(max_call_depth);
+            simulator.setTraceMode(trace_mode, trace_filename);
+            simulator.setSymbols(code_symbols);
+            if (!checkpoint_filename.empty()) {
+                uint32_t offset = 0;
+                bool found = false;
+                for (const auto& sym : code_symbols) {
+                    if (sym.defined && sym.type == 0 && sym.name == checkpoint_at) {
+                        offset = sym.address;
+                        found = true;
+                    }
+                }
+                if (!found) {
+                    if (checkpoint_at.empty() || checkpoint_at.find_first_not_of("0123456789") != std::string::npos) {
+                        throw std::runtime_error("Checkpoint location is neither a TEXT symbol nor an offset: " + checkpoint_at);
+                    }
+                    offset = static_cast<uint32_t>(std::stoul(checkpoint_at));
+                }
+                simulator.setCheckpoint(checkpoint_filename, offset);
+            }
+            if (!restore_filename.empty()) {
+                simulator.restoreSnapshot(restore_filename);
+                std::cout << "Resuming from snapshot " << restore_filename << std::endl;
+            }
+            simulator.run();
+            if (trace_mode != VMSimulator::TraceMode::Listing) std::cout << std::endl; // after the program's own output
+            std::cout << "Exit value: " << simulator.getExitValue()
+                      << " (" << simulator.getInstructionCount() << " instructions executed, "
+                      << simulator.getDispatchesEliminated() << " dispatches eliminated by superinstructions)" << std::endl;
+            if (!checkpoint_filename.empty()) {
+                if (simulator.checkpointTaken()) {
+                    std::cout << "Checkpoint written to " << checkpoint_filename << std::endl;
+                } else {
+                    std::cout << "Checkpoint at " << checkpoint_at << " was never reached" << std::endl;
+                }
+            }
+            if (simulator.ranNative()) {
+                std::cout << "JIT: " << simulator.getJit().functionCount() << " functions compiled to "
+                          << simulator.getJit().codeBytes() << " bytes of x86-64" << std::endl;
+            }
+            if (trace_mode == VMSimulator::TraceMode::Profile) {
+                std::ofstream report(profile_name + ".txt");
+                std::ofstream collapsed(profile_name + ".folded");
+                if (!report.is_open() || !collapsed.is_open()) {
+                    throw std::runtime_error("Cannot open profile output: " + profile_name);
+                }
+                simulator.writeProfile(report, collapsed);
+                std::cout << "Profile written to " << profile_name << ".txt and " << profile_name << ".folded" << std::endl;
+            }
+        }
 
         // // --- Stage 3: MIPS Generation ---
         // // Pass the *new* processed list to the generator
         MipsGenerator generator(processed_instructions); 
-        std::vector<std::string> mips_assembly = generator.generate("output.s", stack_size_max, symbol_table);
+        MipsProgram mips_program = generator.generate(code_symbols, emit_asm);
         std::cout << "\n--- Generated MIPS Assembly ---" << std::endl;
-        // for (const auto& line : mips_assembly) {
-        //     std::cout << line;
-        // }
         std::cout << "\nMIPS assembly Generated Successfully\n";
-        // // (Printing loop removed, as it's in the generator now)
+
+        std::cout << "\nFrames: operand stack " << generator.layout.operand_stack << " slots"
+                  << (generator.layout.recursive ? " (checked on every call)" : "") << std::endl;
+        for (const FrameLayout& frame : generator.layout.frames) {
+            std::cout << "  " << frame.function << ": " << frame.bytes << " bytes, " << frame.locals << " local"
+                      << (frame.locals == 1 ? "" : "s") << ", " << frame.saved << " saved register"
+                      << (frame.saved == 1 ? "" : "s") << (frame.leaf ? ", leaf" : "");
+            if (frame.tail_calls > 0) std::cout << ", " << frame.tail_calls << " tail call" << (frame.tail_calls == 1 ? "" : "s");
+            std::cout << std::endl;
+        }
+        std::cout << "\nLoops: " << generator.loops.size() << " with locals in registers" << std::endl;
+        for (const LoopLayout& loop : generator.loops) {
+            std::cout << "  L" << loop.header << " in " << loop.function << ": " << loop.blocks << " block"
+                      << (loop.blocks == 1 ? "" : "s");
+            for (const auto& local : loop.locals) std::cout << ", local " << local.first << " in " << local.second;
+            std::cout << std::endl;
+        }
+
+        if (peephole) {
+            PeepholeOptimizer optimizer;
+            if (!peephole_rules.empty()) optimizer.setRules(peephole_rules);
+            optimizer.optimize(mips_program.code);
+            std::cout << std::endl;
+            optimizer.writeReport(std::cout);
+        }
+        if (schedule) {
+            InstructionScheduler scheduler;
+            scheduler.schedule(mips_program.code);
+            std::cout << std::endl;
+            scheduler.writeReport(std::cout);
+        }
+        if (emit_asm) {
+            std::ofstream assembly("output.s");
+            if (!assembly.is_open()) throw std::runtime_error("Could not open output file: output.s");
+            mips_program.writeAssembly(assembly);
+        }
         
         MipsAssembler assembler;
-        assembler.assemble(mips_assembly, "output.hex");
-        std::cout << "\nSuccessfully generated MIPS assembly in output.s and machine code in output.hex" << std::endl;
+        assembler.assemble(mips_program, "output.hex");
+        std::cout << "\nSuccessfully generated " << (emit_asm ? "MIPS assembly in output.s and " : "")
+                  << "machine code in output.hex" << std::endl;
+
+        // --- Stage 4: MIPS Simulation ---
+        if (run_mips) {
+            MipsSimulator mips;
+            mips.loadHex("output.hex");
+            if (mips_timing) {
+                mips.enableTiming(parseCacheConfig(icache_geometry), parseCacheConfig(dcache_geometry));
+            }
+            std::cout << "\n--- MIPS Simulation ---" << std::endl;
+            mips.run();
+            std::cout << std::endl;
+            std::cout << "MIPS exit code: " << mips.getExitCode()
+                      << " (" << mips.getRetiredCount() << " instructions retired)" << std::endl;
+            if (mips_timing) {
+                std::cout << std::endl;
+                mips.getTiming().writeReport(std::cout);
+            }
+        }
         
     } catch (const std::runtime_error& e) {
         std::cerr << "Error: " << e.what() << std::endl;
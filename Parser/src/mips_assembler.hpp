@@ -1,21 +1,22 @@
 #ifndef MIPS_ASSEMBLER_HPP
 #define MIPS_ASSEMBLER_HPP
 
+#include "mips_instruction.hpp"
 #include <string>
 #include <vector>
-#include <map>
 #include <cstdint> // <-- Added for uint8_t, uint32_t
 
 class MipsAssembler {
 public:
     MipsAssembler();
-    void assemble(const std::vector<std::string>& assembly_lines, const std::string& output_filename);
+    // Encodes `program`, one word per instruction, and writes the words to
+    // `output_filename` as hex, one per line
+    std::vector<uint32_t> assemble(const MipsProgram& program, const std::string& output_filename);
 
 private:
-    std::map<std::string, uint8_t> registerMap;
-    std::map<std::string, uint32_t> symbolTable;
+    std::vector<uint32_t> labelAddresses; // by label id, UINT32_MAX until defined
 
-    std::vector<uint32_t> instructionToMachineCode(const std::string& line, uint32_t current_address);
+    uint32_t instructionToMachineCode(const MipsProgram& program, const MipsInstruction& instr, uint32_t current_address) const;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -2,15 +2,45 @@
 #define MIPS_GENERATOR_HPP
 
 #include "parser.hpp"
+#include "mips_instruction.hpp"
+#include <cstdint>
 #include <string>
+#include <utility>
 #include <vector>// Include the new header
 #include "symbol_table.hpp" // Include the symbol table header
-#include "address_space.hpp"
+
+// One function's frame as generate() laid it out
+struct FrameLayout {
+    std::string function; // TEXT symbol at its start, or L<offset>
+    int locals;
+    int saved; // callee-saved registers
+    int bytes;
+    bool leaf;      // no call but tail calls, so $ra is not saved
+    int tail_calls; // INVOKEs that reuse the frame
+};
+
+struct StackLayout {
+    std::vector<FrameLayout> frames; // in code order
+    size_t operand_stack;            // slots reserved below the initial $sp
+    bool recursive;                  // operand_stack is then a bound for 1024 nested calls, at least 2 MB, checked on every call
+};
+
+// An innermost loop whose locals generate() kept in registers
+struct LoopLayout {
+    std::string function;
+    uint32_t header; // offset of its first instruction
+    size_t blocks;
+    std::vector<std::pair<int, std::string>> locals; // local, register
+};
+
 class MipsGenerator {
 public:
     MipsGenerator(const std::vector<Instruction>& instructions);
-    std::vector<std::string> generate(const std::string& output_filename, int stack_size_max,  const std::vector<SymbolEntry>& symbol_table);
-    AddressSpace addr_space;
+    // The program as typed instructions; `annotate` keeps comments naming
+    // the bytecode each part comes from, for writing output.s
+    MipsProgram generate(const std::vector<SymbolEntry>& symbol_table, bool annotate = false);
+    StackLayout layout; // of the last generate()
+    std::vector<LoopLayout> loops;
     
 private:
     const std::vector<Instruction>& instructions;
@@ -0,0 +1,240 @@
+#include "mips_instruction.hpp"
+#include <stdexcept>
+
+namespace {
+
+const char* const kRegisterNames[32] = {
+    "$zero", "$at", "$v0", "$v1", "$a0", "$a1", "$a2", "$a3",
+    "$t0", "$t1", "$t2", "$t3", "$t4", "$t5", "$t6", "$t7",
+    "$s0", "$s1", "$s2", "$s3", "$s4", "$s5", "$s6", "$s7",
+    "$t8", "$t9", "$k0", "$k1", "$gp", "$sp", "$fp", "$ra"};
+
+// In MipsOp order
+const char* const kMnemonics[] = {
+    "add", "addu", "sub", "subu", "and", "or", "xor", "nor", "slt", "sltu",
+    "sll", "srl", "sra",
+    "mult", "div",
+    "mflo", "mfhi",
+    "jr", "jalr",
+    "syscall", "break", "nop",
+    "addi", "addiu", "andi", "ori", "xori", "slti", "sltiu",
+    "lui",
+    "lw", "lb", "sw", "sb",
+    "beq", "bne",
+    "blez", "bgtz", "bltz", "bgez",
+    "j", "jal",
+    "", ""};
+
+bool isRegisterOp(MipsOp op) {
+    return op >= MipsOp::ADD && op <= MipsOp::SLTU;
+}
+
+bool isShift(MipsOp op) {
+    return op >= MipsOp::SLL && op <= MipsOp::SRA;
+}
+
+bool isImmediateOp(MipsOp op) {
+    return op >= MipsOp::ADDI && op <= MipsOp::LUI;
+}
+
+} // namespace
+
+MipsInstruction mipsR(MipsOp op, uint8_t rd, uint8_t rs, uint8_t rt) {
+    return MipsInstruction{op, rd, rs, rt, 0, -1};
+}
+
+MipsInstruction mipsShift(MipsOp op, uint8_t rd, uint8_t rt, int amount) {
+    return MipsInstruction{op, rd, kZero, rt, amount, -1};
+}
+
+MipsInstruction mipsI(MipsOp op, uint8_t rt, uint8_t rs, int32_t imm) {
+    return MipsInstruction{op, kZero, rs, rt, imm, -1};
+}
+
+MipsInstruction mipsBranch(MipsOp op, uint8_t rs, uint8_t rt, int label) {
+    return MipsInstruction{op, kZero, rs, rt, 0, label};
+}
+
+MipsInstruction mipsJump(MipsOp op, int label) {
+    return MipsInstruction{op, kZero, kZero, kZero, 0, label};
+}
+
+MipsInstruction mipsJr(MipsOp op, uint8_t rs) {
+    return MipsInstruction{op, op == MipsOp::JALR ? kRa : kZero, rs, kZero, 0, -1};
+}
+
+MipsInstruction mipsOp(MipsOp op, int32_t imm) {
+    return MipsInstruction{op, kZero, kZero, kZero, imm, -1};
+}
+
+MipsInstruction mipsLabel(int label) {
+    return MipsInstruction{MipsOp::LABEL, kZero, kZero, kZero, 0, label};
+}
+
+MipsInstruction mipsComment(int comment) {
+    return MipsInstruction{MipsOp::COMMENT, kZero, kZero, kZero, comment, -1};
+}
+
+const char* mnemonic(MipsOp op) {
+    return kMnemonics[static_cast<int>(op)];
+}
+
+const char* registerName(int reg) {
+    return (reg >= 0 && reg < 32) ? kRegisterNames[reg] : "$?";
+}
+
+int registerNumber(const std::string& name) {
+    for (int reg = 0; reg < 32; ++reg) {
+        if (name == kRegisterNames[reg]) return reg;
+    }
+    return -1;
+}
+
+bool isCode(MipsOp op) {
+    return op != MipsOp::LABEL && op != MipsOp::COMMENT;
+}
+
+bool isConditionalBranch(MipsOp op) {
+    return op >= MipsOp::BEQ && op <= MipsOp::BGEZ;
+}
+
+bool isBranch(MipsOp op) {
+    return isConditionalBranch(op) || op == MipsOp::J || op == MipsOp::JAL || op == MipsOp::JR || op == MipsOp::JALR;
+}
+
+bool isLoad(MipsOp op) {
+    return op == MipsOp::LW || op == MipsOp::LB;
+}
+
+bool isStore(MipsOp op) {
+    return op == MipsOp::SW || op == MipsOp::SB;
+}
+
+bool isPure(MipsOp op) {
+    return isRegisterOp(op) || isShift(op) || isImmediateOp(op);
+}
+
+bool writesHiLo(MipsOp op) {
+    return op == MipsOp::MULT || op == MipsOp::DIV;
+}
+
+bool readsHiLo(MipsOp op) {
+    return op == MipsOp::MFLO || op == MipsOp::MFHI;
+}
+
+bool isBarrier(MipsOp op) {
+    return op == MipsOp::SYSCALL || op == MipsOp::BREAK;
+}
+
+int destination(const MipsInstruction& instr) {
+    int reg = -1;
+    if (isRegisterOp(instr.op) || isShift(instr.op) || readsHiLo(instr.op) || instr.op == MipsOp::JALR) {
+        reg = instr.rd;
+    } else if (isImmediateOp(instr.op) || isLoad(instr.op)) {
+        reg = instr.rt;
+    } else if (instr.op == MipsOp::JAL) {
+        reg = kRa;
+    }
+    return reg == kZero ? -1 : reg;
+}
+
+bool writesRegister(const MipsInstruction& instr, int reg) {
+    if (reg == kZero) return false;
+    return isBarrier(instr.op) || destination(instr) == reg;
+}
+
+bool readsRegister(const MipsInstruction& instr, int reg) {
+    MipsOp op = instr.op;
+    if (isBarrier(op)) return true;
+    if (isRegisterOp(op) || writesHiLo(op) || op == MipsOp::BEQ || op == MipsOp::BNE || isStore(op)) {
+        return instr.rs == reg || instr.rt == reg;
+    }
+    if (isShift(op)) return instr.rt == reg;
+    if (op == MipsOp::LUI) return false;
+    if (isImmediateOp(op) || isLoad(op) || isConditionalBranch(op) || op == MipsOp::JR || op == MipsOp::JALR) {
+        return instr.rs == reg;
+    }
+    return false;
+}
+
+bool sameInstruction(const MipsInstruction& a, const MipsInstruction& b) {
+    return a.op == b.op && a.rd == b.rd && a.rs == b.rs && a.rt == b.rt && a.imm == b.imm && a.label == b.label;
+}
+
+MipsProgram::MipsProgram(bool annotate) : annotate(annotate) {}
+
+int MipsProgram::label(const std::string& name) {
+    auto it = label_ids.find(name);
+    if (it != label_ids.end()) return it->second;
+    int id = static_cast<int>(label_names.size());
+    label_names.push_back(name);
+    label_ids[name] = id;
+    return id;
+}
+
+const std::string& MipsProgram::labelName(int id) const {
+    if (id < 0 || id >= static_cast<int>(label_names.size())) throw std::runtime_error("Invalid label id");
+    return label_names[id];
+}
+
+size_t MipsProgram::labelCount() const {
+    return label_names.size();
+}
+
+bool MipsProgram::annotated() const {
+    return annotate;
+}
+
+int MipsProgram::addComment(const std::string& text) {
+    if (!annotate) return -1;
+    comments.push_back(text);
+    return static_cast<int>(comments.size()) - 1;
+}
+
+void MipsProgram::writeAssembly(std::ostream& out) const {
+    out << ".data\n.text\n.global main\n\n";
+    for (const MipsInstruction& instr : code) {
+        MipsOp op = instr.op;
+        if (op == MipsOp::LABEL) {
+            out << labelName(instr.label) << ":\n";
+            continue;
+        }
+        if (op == MipsOp::COMMENT) {
+            if (instr.imm >= 0 && instr.imm < static_cast<int>(comments.size())) out << "    # " << comments[instr.imm] << "\n";
+            continue;
+        }
+        std::string name = mnemonic(op);
+        out << "    " << name;
+        if (op == MipsOp::NOP || op == MipsOp::SYSCALL) {
+            out << "\n";
+            continue;
+        }
+        out << std::string(name.size() < 6 ? 6 - name.size() : 1, ' ');
+        if (isRegisterOp(op)) {
+            out << registerName(instr.rd) << ", " << registerName(instr.rs) << ", " << registerName(instr.rt);
+        } else if (isShift(op)) {
+            out << registerName(instr.rd) << ", " << registerName(instr.rt) << ", " << instr.imm;
+        } else if (writesHiLo(op)) {
+            out << registerName(instr.rs) << ", " << registerName(instr.rt);
+        } else if (readsHiLo(op)) {
+            out << registerName(instr.rd);
+        } else if (op == MipsOp::JR || op == MipsOp::JALR) {
+            out << registerName(instr.rs);
+        } else if (op == MipsOp::BREAK) {
+            out << instr.imm;
+        } else if (op == MipsOp::LUI) {
+            out << registerName(instr.rt) << ", " << instr.imm;
+        } else if (isImmediateOp(op)) {
+            out << registerName(instr.rt) << ", " << registerName(instr.rs) << ", " << instr.imm;
+        } else if (isLoad(op) || isStore(op)) {
+            out << registerName(instr.rt) << ", " << instr.imm << "(" << registerName(instr.rs) << ")";
+        } else if (op == MipsOp::BEQ || op == MipsOp::BNE) {
+            out << registerName(instr.rs) << ", " << registerName(instr.rt) << ", " << labelName(instr.label);
+        } else if (isConditionalBranch(op)) {
+            out << registerName(instr.rs) << ", " << labelName(instr.label);
+        } else {
+            out << labelName(instr.label);
+        }
+        out << "\n";
+    }
+}
@@ -0,0 +1,110 @@
+#ifndef MIPS_INSTRUCTION_HPP
+#define MIPS_INSTRUCTION_HPP
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// The generator's output as the passes after it (peephole.cpp,
+// scheduler.cpp) and the assembler see it: one MipsInstruction per machine
+// word, with registers as numbers and branch targets as label ids. Text is
+// produced only by MipsProgram::writeAssembly().
+
+// Register numbers used by name in the generator
+enum MipsRegister : uint8_t {
+    kZero = 0, kAt = 1, kV0 = 2, kV1 = 3,
+    kA0 = 4, kA1 = 5, kA2 = 6, kA3 = 7,
+    kT0 = 8, kT1 = 9, kT2 = 10, kT3 = 11, kT4 = 12,
+    kT9 = 25, kGp = 28, kSp = 29, kRa = 31
+};
+
+enum class MipsOp : uint8_t {
+    ADD, ADDU, SUB, SUBU, AND, OR, XOR, NOR, SLT, SLTU, // rd = rs op rt
+    SLL, SRL, SRA,                                     // rd = rt shifted by imm
+    MULT, DIV,                                         // HI/LO = rs op rt
+    MFLO, MFHI,                                        // rd = LO / HI
+    JR, JALR,                                          // to rs; jalr links in rd
+    SYSCALL, BREAK, NOP,                               // break code in imm
+    ADDI, ADDIU, ANDI, ORI, XORI, SLTI, SLTIU,         // rt = rs op imm
+    LUI,                                               // rt = imm << 16
+    LW, LB, SW, SB,                                    // rt and memory at imm(rs)
+    BEQ, BNE,                                          // to label when rs ==/!= rt
+    BLEZ, BGTZ, BLTZ, BGEZ,                            // to label by rs against 0
+    J, JAL,                                            // to label
+    LABEL,                                             // defines label; no code
+    COMMENT                                            // comment imm of the program; no code
+};
+
+struct MipsInstruction {
+    MipsOp op;
+    uint8_t rd;
+    uint8_t rs;
+    uint8_t rt;
+    int32_t imm;
+    int32_t label; // target or defined label id, -1 for none
+};
+
+MipsInstruction mipsR(MipsOp op, uint8_t rd, uint8_t rs, uint8_t rt);
+MipsInstruction mipsShift(MipsOp op, uint8_t rd, uint8_t rt, int amount);
+MipsInstruction mipsI(MipsOp op, uint8_t rt, uint8_t rs, int32_t imm); // loads and stores too, rs the base
+MipsInstruction mipsBranch(MipsOp op, uint8_t rs, uint8_t rt, int label); // rt unused against 0
+MipsInstruction mipsJump(MipsOp op, int label);
+MipsInstruction mipsJr(MipsOp op, uint8_t rs); // jr, or jalr linking in $ra
+MipsInstruction mipsOp(MipsOp op, int32_t imm = 0); // nop, syscall, break
+MipsInstruction mipsLabel(int label);
+MipsInstruction mipsComment(int comment);
+
+const char* mnemonic(MipsOp op);
+const char* registerName(int reg);
+// Number of a register named like "$t5", -1 for anything else
+int registerNumber(const std::string& name);
+
+bool isCode(MipsOp op); // not a label or a comment
+bool isConditionalBranch(MipsOp op);
+bool isBranch(MipsOp op); // the conditional branches and every jump
+bool isLoad(MipsOp op);
+bool isStore(MipsOp op);
+// Register-to-register and immediate ALU ops: the result depends on the
+// operands alone
+bool isPure(MipsOp op);
+bool writesHiLo(MipsOp op);
+bool readsHiLo(MipsOp op);
+// syscall and break may read and write any register or memory
+bool isBarrier(MipsOp op);
+
+// The register written, -1 for none ($zero counts as none)
+int destination(const MipsInstruction& instr);
+bool writesRegister(const MipsInstruction& instr, int reg);
+bool readsRegister(const MipsInstruction& instr, int reg);
+bool sameInstruction(const MipsInstruction& a, const MipsInstruction& b);
+
+// The generated code with the names of its labels. Comments are kept only
+// when the program is annotated, for writing it out as text.
+class MipsProgram {
+public:
+    explicit MipsProgram(bool annotate = false);
+
+    std::vector<MipsInstruction> code;
+
+    // Id of label `name`, created on first use
+    int label(const std::string& name);
+    const std::string& labelName(int id) const;
+    size_t labelCount() const;
+
+    bool annotated() const;
+    // Adds `text` for a COMMENT, -1 when the program is not annotated
+    int addComment(const std::string& text);
+
+    // As assembly text for a standard assembler, entry point main
+    void writeAssembly(std::ostream& out) const;
+
+private:
+    bool annotate;
+    std::vector<std::string> comments;
+    std::vector<std::string> label_names;
+    std::map<std::string, int> label_ids;
+};
+
+#endif
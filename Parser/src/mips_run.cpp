@@ -0,0 +1,52 @@
+// Runs MIPS machine code on MipsSimulator without qemu-mips.
+// Usage: mips_run <output.hex | program.bin> [max instructions]
+//                 [--timing] [--icache=SIZE:LINE] [--dcache=SIZE:LINE]
+#include "mips_simulator.hpp"
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <output.hex | program.bin> [max instructions]"
+                  << " [--timing] [--icache=SIZE:LINE] [--dcache=SIZE:LINE]" << std::endl;
+        return 1;
+    }
+    try {
+        const std::string filename = argv[1];
+        MipsSimulator mips;
+        if (filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".hex") == 0) {
+            mips.loadHex(filename);
+        } else {
+            mips.loadBinary(filename);
+        }
+        bool timing = false;
+        std::string icache = "4096:16";
+        std::string dcache = "4096:16";
+        for (int i = 2; i < argc; ++i) {
+            const std::string option = argv[i];
+            if (option == "--timing") {
+                timing = true;
+            } else if (option.rfind("--icache=", 0) == 0) {
+                icache = option.substr(9);
+            } else if (option.rfind("--dcache=", 0) == 0) {
+                dcache = option.substr(9);
+            } else {
+                mips.setInstructionLimit(std::strtoull(option.c_str(), nullptr, 10));
+            }
+        }
+        if (timing) mips.enableTiming(parseCacheConfig(icache), parseCacheConfig(dcache));
+        mips.run();
+        std::cout << std::endl;
+        std::cout << "Exit code: " << mips.getExitCode() << " (" << mips.getRetiredCount() << " instructions retired)" << std::endl;
+        if (timing) {
+            std::cout << std::endl;
+            mips.getTiming().writeReport(std::cout);
+        }
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
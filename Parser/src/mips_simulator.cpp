@@ -0,0 +1,396 @@
+#include "mips_simulator.hpp"
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+std::string hexWord(uint32_t value) {
+    std::ostringstream out;
+    out << "0x" << std::hex;
+    out.width(8);
+    out.fill('0');
+    out << value;
+    return out.str();
+}
+
+} // namespace
+
+MipsSimulator::MipsSimulator() : lo(0), hi(0), heap_break(0), exited(false), exit_code(0), retired(0), limit(0), timed(false) {
+    std::memset(regs, 0, sizeof(regs));
+}
+
+void MipsSimulator::loadHex(const std::string& filename) {
+    std::ifstream in(filename);
+    if (!in.is_open()) {
+        throw std::runtime_error("Cannot open MIPS hex file: " + filename);
+    }
+    std::vector<uint32_t> words;
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos) continue;
+        size_t used = 0;
+        unsigned long word = 0;
+        try {
+            word = std::stoul(line.substr(first), &used, 16);
+        } catch (const std::exception&) {
+            used = 0;
+        }
+        if (used == 0 || word > 0xFFFFFFFFul) {
+            throw std::runtime_error("Bad instruction word in " + filename + ": " + line);
+        }
+        words.push_back(static_cast<uint32_t>(word));
+    }
+    load(words);
+}
+
+void MipsSimulator::loadBinary(const std::string& filename) {
+    std::ifstream in(filename, std::ios::binary);
+    if (!in.is_open()) {
+        throw std::runtime_error("Cannot open MIPS binary: " + filename);
+    }
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (bytes.size() % 4 != 0) {
+        throw std::runtime_error("MIPS binary is not a whole number of words: " + filename);
+    }
+    std::vector<uint32_t> words(bytes.size() / 4);
+    for (size_t i = 0; i < words.size(); ++i) {
+        const uint8_t* p = &bytes[i * 4];
+        words[i] = (static_cast<uint32_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+    }
+    load(words);
+}
+
+void MipsSimulator::load(const std::vector<uint32_t>& words) {
+    if (words.size() * 4 > kStackTop / 2) {
+        throw std::runtime_error("MIPS program does not fit in simulator memory");
+    }
+    memory.assign(kMemoryBytes, 0);
+    text = words;
+    code.clear();
+    code.reserve(words.size());
+    for (uint32_t i = 0; i < words.size(); ++i) {
+        uint8_t* p = &memory[i * 4];
+        p[0] = static_cast<uint8_t>(words[i] >> 24);
+        p[1] = static_cast<uint8_t>(words[i] >> 16);
+        p[2] = static_cast<uint8_t>(words[i] >> 8);
+        p[3] = static_cast<uint8_t>(words[i]);
+        code.push_back(decode(words[i], i));
+    }
+
+    std::memset(regs, 0, sizeof(regs));
+    regs[29] = kStackTop; // $sp
+    lo = hi = 0;
+    heap_break = (static_cast<uint32_t>(words.size()) * 4 + 7) & ~7u;
+    exited = false;
+    exit_code = 0;
+    retired = 0;
+    timing.reset(text);
+}
+
+void MipsSimulator::enableTiming(const MipsCacheConfig& icache, const MipsCacheConfig& dcache) {
+    timed = true;
+    timing.configure(icache, dcache);
+    timing.reset(text);
+}
+
+const MipsTiming& MipsSimulator::getTiming() const {
+    return timing;
+}
+
+void MipsSimulator::setInstructionLimit(uint64_t max_instructions) {
+    limit = max_instructions;
+}
+
+int32_t MipsSimulator::getExitCode() const {
+    return exit_code;
+}
+
+uint64_t MipsSimulator::getRetiredCount() const {
+    return retired;
+}
+
+uint32_t MipsSimulator::getRegister(int reg) const {
+    return regs[reg];
+}
+
+MipsSimulator::Decoded MipsSimulator::decode(uint32_t word, uint32_t index) const {
+    uint8_t rs = (word >> 21) & 31;
+    uint8_t rt = (word >> 16) & 31;
+    uint8_t rd = (word >> 11) & 31;
+    int32_t simm = static_cast<int16_t>(word & 0xFFFF);
+    int32_t zimm = static_cast<int32_t>(word & 0xFFFF);
+    uint8_t rt_dest = rt == 0 ? kScratch : rt;
+    uint8_t rd_dest = rd == 0 ? kScratch : rd;
+    Decoded invalid{Op::INVALID, 0, 0, 0, static_cast<int32_t>(word)};
+
+    switch (word >> 26) {
+        case 0x00: {
+            Op op;
+            switch (word & 63) {
+                case 0x00:
+                    if (word == 0) return Decoded{Op::NOP, 0, 0, 0, 0};
+                    return Decoded{Op::SLL, 0, rt, rd_dest, static_cast<int32_t>((word >> 6) & 31)};
+                case 0x02: return Decoded{Op::SRL, 0, rt, rd_dest, static_cast<int32_t>((word >> 6) & 31)};
+                case 0x03: return Decoded{Op::SRA, 0, rt, rd_dest, static_cast<int32_t>((word >> 6) & 31)};
+                case 0x0D: return Decoded{Op::BREAK, 0, 0, 0, static_cast<int32_t>((word >> 6) & 0xFFFFF)};
+                case 0x10: op = Op::MFHI; break;
+                case 0x08: op = Op::JR; break;
+                case 0x09: op = Op::JALR; break;
+                case 0x0C: op = Op::SYSCALL; break;
+                case 0x12: op = Op::MFLO; break;
+                case 0x18: op = Op::MULT; break;
+                case 0x1A: op = Op::DIV; break;
+                case 0x20: op = Op::ADD; break;
+                case 0x21: op = Op::ADDU; break;
+                case 0x22: op = Op::SUB; break;
+                case 0x23: op = Op::SUBU; break;
+                case 0x24: op = Op::AND; break;
+                case 0x25: op = Op::OR; break;
+                case 0x26: op = Op::XOR; break;
+                case 0x27: op = Op::NOR; break;
+                case 0x2A: op = Op::SLT; break;
+                case 0x2B: op = Op::SLTU; break;
+                default: return invalid;
+            }
+            return Decoded{op, rs, rt, rd_dest, 0};
+        }
+        case 0x02: case 0x03: {
+            // 26-bit word index within the 256 MB region of the delay slot
+            uint32_t target = (((index + 1) * 4) & 0xF0000000u) | ((word & 0x03FFFFFFu) << 2);
+            return Decoded{(word >> 26) == 0x02 ? Op::J : Op::JAL, 0, 0, 0, static_cast<int32_t>(target / 4)};
+        }
+        case 0x01:
+            if (rt > 1) return invalid; // only bltz and bgez of the REGIMM group
+            return Decoded{rt == 0 ? Op::BLTZ : Op::BGEZ, rs, 0, 0, static_cast<int32_t>(index + 1) + simm};
+        case 0x04: return Decoded{Op::BEQ, rs, rt, 0, static_cast<int32_t>(index + 1) + simm};
+        case 0x05: return Decoded{Op::BNE, rs, rt, 0, static_cast<int32_t>(index + 1) + simm};
+        case 0x06: return Decoded{Op::BLEZ, rs, 0, 0, static_cast<int32_t>(index + 1) + simm};
+        case 0x07: return Decoded{Op::BGTZ, rs, 0, 0, static_cast<int32_t>(index + 1) + simm};
+        case 0x08: return Decoded{Op::ADDI, rs, 0, rt_dest, simm};
+        case 0x09: return Decoded{Op::ADDIU, rs, 0, rt_dest, simm};
+        case 0x0A: return Decoded{Op::SLTI, rs, 0, rt_dest, simm};
+        case 0x0B: return Decoded{Op::SLTIU, rs, 0, rt_dest, simm};
+        case 0x0C: return Decoded{Op::ANDI, rs, 0, rt_dest, zimm};
+        case 0x0D: return Decoded{Op::ORI, rs, 0, rt_dest, zimm};
+        case 0x0E: return Decoded{Op::XORI, rs, 0, rt_dest, zimm};
+        case 0x0F: return Decoded{Op::LUI, 0, 0, rt_dest, static_cast<int32_t>(static_cast<uint32_t>(zimm) << 16)};
+        case 0x20: return Decoded{Op::LB, rs, 0, rt_dest, simm};
+        case 0x23: return Decoded{Op::LW, rs, 0, rt_dest, simm};
+        case 0x28: return Decoded{Op::SB, rs, rt, 0, simm};
+        case 0x2B: return Decoded{Op::SW, rs, rt, 0, simm};
+        default: return invalid;
+    }
+}
+
+uint8_t* MipsSimulator::at(uint32_t addr, uint32_t bytes) {
+    if (addr > memory.size() - bytes) {
+        throw std::runtime_error("Address error: " + hexWord(addr));
+    }
+    return memory.data() + addr;
+}
+
+void MipsSimulator::syscall() {
+    uint32_t a0 = regs[4];
+    switch (regs[2]) { // $v0
+        case 1:
+            std::cout << static_cast<int32_t>(a0);
+            break;
+        case 4:
+            for (const uint8_t* c = at(a0, 1); *c != 0; c = at(++a0, 1)) {
+                std::cout << static_cast<char>(*c);
+            }
+            break;
+        case 9: {
+            int32_t bytes = static_cast<int32_t>(a0);
+            uint64_t next = heap_break + ((static_cast<uint64_t>(bytes) + 3) & ~3ull);
+            if (bytes < 0 || next > regs[29]) {
+                throw std::runtime_error("sbrk of " + std::to_string(bytes) + " bytes runs into the stack");
+            }
+            regs[2] = heap_break;
+            heap_break = static_cast<uint32_t>(next);
+            break;
+        }
+        case 10: case 17:
+            exit_code = static_cast<int32_t>(a0);
+            exited = true;
+            break;
+        default:
+            throw std::runtime_error("Unsupported syscall " + std::to_string(regs[2]));
+    }
+}
+
+void MipsSimulator::run() {
+    if (timed) {
+        execute<true>();
+    } else {
+        execute<false>();
+    }
+}
+
+// `pc` is the instruction to run and `npc` the one after it; a taken
+// branch only changes `npc`, so its delay slot still runs first.
+template <bool Timed>
+void MipsSimulator::execute() {
+    const Decoded* const text = code.data();
+    const uint32_t size = static_cast<uint32_t>(code.size());
+    const uint64_t max_retired = limit ? limit : UINT64_MAX;
+    uint32_t* const r = regs;
+    uint32_t pc = 0;
+    uint32_t npc = 1;
+    uint32_t cur = 0;
+
+    try {
+        while (!exited) {
+            cur = pc;
+            if (cur >= size) throw std::runtime_error("Execution left the text section");
+            if (retired >= max_retired) throw std::runtime_error("Instruction limit reached");
+            const Decoded& d = text[cur];
+            pc = npc;
+            npc = pc + 1;
+            ++retired;
+            if (Timed) timing.step(cur);
+
+            switch (d.op) {
+                case Op::NOP:
+                    break;
+                case Op::ADD: {
+                    int64_t sum = static_cast<int64_t>(static_cast<int32_t>(r[d.rs])) + static_cast<int32_t>(r[d.rt]);
+                    if (sum != static_cast<int32_t>(sum)) throw std::runtime_error("Arithmetic overflow in add");
+                    r[d.rd] = static_cast<uint32_t>(sum);
+                    break;
+                }
+                case Op::ADDU: r[d.rd] = r[d.rs] + r[d.rt]; break;
+                case Op::SUB: {
+                    int64_t diff = static_cast<int64_t>(static_cast<int32_t>(r[d.rs])) - static_cast<int32_t>(r[d.rt]);
+                    if (diff != static_cast<int32_t>(diff)) throw std::runtime_error("Arithmetic overflow in sub");
+                    r[d.rd] = static_cast<uint32_t>(diff);
+                    break;
+                }
+                case Op::SUBU: r[d.rd] = r[d.rs] - r[d.rt]; break;
+                case Op::SLL: r[d.rd] = r[d.rt] << d.imm; break;
+                case Op::SRL: r[d.rd] = r[d.rt] >> d.imm; break;
+                case Op::SRA: r[d.rd] = static_cast<uint32_t>(static_cast<int32_t>(r[d.rt]) >> d.imm); break;
+                case Op::AND: r[d.rd] = r[d.rs] & r[d.rt]; break;
+                case Op::OR: r[d.rd] = r[d.rs] | r[d.rt]; break;
+                case Op::XOR: r[d.rd] = r[d.rs] ^ r[d.rt]; break;
+                case Op::NOR: r[d.rd] = ~(r[d.rs] | r[d.rt]); break;
+                case Op::SLT: r[d.rd] = static_cast<int32_t>(r[d.rs]) < static_cast<int32_t>(r[d.rt]); break;
+                case Op::SLTU: r[d.rd] = r[d.rs] < r[d.rt]; break;
+                case Op::MULT: {
+                    int64_t product = static_cast<int64_t>(static_cast<int32_t>(r[d.rs])) * static_cast<int32_t>(r[d.rt]);
+                    lo = static_cast<uint32_t>(product);
+                    hi = static_cast<uint32_t>(static_cast<uint64_t>(product) >> 32);
+                    break;
+                }
+                case Op::DIV: {
+                    // The R3000 leaves HI/LO undefined for a zero divisor
+                    int32_t n = static_cast<int32_t>(r[d.rs]);
+                    int32_t q = static_cast<int32_t>(r[d.rt]);
+                    if (q == 0) break;
+                    if (n == INT_MIN && q == -1) {
+                        lo = static_cast<uint32_t>(INT_MIN);
+                        hi = 0;
+                    } else {
+                        lo = static_cast<uint32_t>(n / q);
+                        hi = static_cast<uint32_t>(n % q);
+                    }
+                    break;
+                }
+                case Op::MFLO: r[d.rd] = lo; break;
+                case Op::MFHI: r[d.rd] = hi; break;
+                case Op::JR:
+                case Op::JALR: {
+                    uint32_t target = r[d.rs];
+                    if (target & 3) throw std::runtime_error("Unaligned jump to " + hexWord(target));
+                    if (d.op == Op::JALR) r[d.rd] = (cur + 2) * 4;
+                    npc = target / 4;
+                    break;
+                }
+                case Op::SYSCALL: syscall(); break;
+                case Op::BREAK:
+                    if (d.imm == 7) throw std::runtime_error("Division by zero");
+                    throw std::runtime_error("Break " + std::to_string(d.imm));
+                case Op::ADDI: {
+                    int64_t sum = static_cast<int64_t>(static_cast<int32_t>(r[d.rs])) + d.imm;
+                    if (sum != static_cast<int32_t>(sum)) throw std::runtime_error("Arithmetic overflow in addi");
+                    r[d.rd] = static_cast<uint32_t>(sum);
+                    break;
+                }
+                case Op::ADDIU: r[d.rd] = r[d.rs] + static_cast<uint32_t>(d.imm); break;
+                case Op::SLTI: r[d.rd] = static_cast<int32_t>(r[d.rs]) < d.imm; break;
+                case Op::SLTIU: r[d.rd] = r[d.rs] < static_cast<uint32_t>(d.imm); break;
+                case Op::ANDI: r[d.rd] = r[d.rs] & static_cast<uint32_t>(d.imm); break;
+                case Op::ORI: r[d.rd] = r[d.rs] | static_cast<uint32_t>(d.imm); break;
+                case Op::XORI: r[d.rd] = r[d.rs] ^ static_cast<uint32_t>(d.imm); break;
+                case Op::LUI: r[d.rd] = static_cast<uint32_t>(d.imm); break;
+                case Op::LW: {
+                    uint32_t addr = r[d.rs] + static_cast<uint32_t>(d.imm);
+                    if (addr & 3) throw std::runtime_error("Unaligned load from " + hexWord(addr));
+                    if (Timed) timing.load(addr);
+                    const uint8_t* p = at(addr, 4);
+                    r[d.rd] = (static_cast<uint32_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+                    break;
+                }
+                case Op::SW: {
+                    uint32_t addr = r[d.rs] + static_cast<uint32_t>(d.imm);
+                    if (addr & 3) throw std::runtime_error("Unaligned store to " + hexWord(addr));
+                    if (Timed) timing.store(addr);
+                    uint8_t* p = at(addr, 4);
+                    uint32_t value = r[d.rt];
+                    p[0] = static_cast<uint8_t>(value >> 24);
+                    p[1] = static_cast<uint8_t>(value >> 16);
+                    p[2] = static_cast<uint8_t>(value >> 8);
+                    p[3] = static_cast<uint8_t>(value);
+                    break;
+                }
+                case Op::LB: {
+                    uint32_t addr = r[d.rs] + static_cast<uint32_t>(d.imm);
+                    if (Timed) timing.load(addr);
+                    r[d.rd] = static_cast<uint32_t>(static_cast<int32_t>(static_cast<int8_t>(*at(addr, 1))));
+                    break;
+                }
+                case Op::SB: {
+                    uint32_t addr = r[d.rs] + static_cast<uint32_t>(d.imm);
+                    if (Timed) timing.store(addr);
+                    *at(addr, 1) = static_cast<uint8_t>(r[d.rt]);
+                    break;
+                }
+                case Op::BEQ:
+                    if (r[d.rs] == r[d.rt]) npc = static_cast<uint32_t>(d.imm);
+                    break;
+                case Op::BNE:
+                    if (r[d.rs] != r[d.rt]) npc = static_cast<uint32_t>(d.imm);
+                    break;
+                case Op::BLEZ:
+                    if (static_cast<int32_t>(r[d.rs]) <= 0) npc = static_cast<uint32_t>(d.imm);
+                    break;
+                case Op::BGTZ:
+                    if (static_cast<int32_t>(r[d.rs]) > 0) npc = static_cast<uint32_t>(d.imm);
+                    break;
+                case Op::BLTZ:
+                    if (static_cast<int32_t>(r[d.rs]) < 0) npc = static_cast<uint32_t>(d.imm);
+                    break;
+                case Op::BGEZ:
+                    if (static_cast<int32_t>(r[d.rs]) >= 0) npc = static_cast<uint32_t>(d.imm);
+                    break;
+                case Op::J:
+                    npc = static_cast<uint32_t>(d.imm);
+                    break;
+                case Op::JAL:
+                    r[31] = (cur + 2) * 4; // past the delay slot
+                    npc = static_cast<uint32_t>(d.imm);
+                    break;
+                case Op::INVALID:
+                    throw std::runtime_error("Unsupported instruction " + hexWord(static_cast<uint32_t>(d.imm)));
+            }
+        }
+    } catch (const std::runtime_error& e) {
+        throw std::runtime_error(std::string(e.what()) + " at " + hexWord(cur * 4));
+    }
+}
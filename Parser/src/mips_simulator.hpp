@@ -0,0 +1,95 @@
+#ifndef MIPS_SIMULATOR_HPP
+#define MIPS_SIMULATOR_HPP
+
+#include "mips_timing.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// In-process MIPS I (R3000) instruction-set simulator for the machine code
+// MipsAssembler writes, so output.hex can be run without qemu-mips. The
+// text is decoded once into `code` and executed from there; it covers the
+// instructions the assembler can encode, with branch delay slots and
+// add/addi/sub overflow traps as on the R3000. `break 7` stops the run
+// with the generator's division-by-zero error. Loads have no delay slot,
+// matching what the generator assumes.
+//
+// Memory is one flat big-endian array: text at address 0, the sbrk heap
+// right after it, and the stack growing down from kStackTop. Syscalls use
+// the SPIM numbering the generator emits: 1 print_int, 4 print_string,
+// 9 sbrk, 10 exit (code in $a0, as the generated epilogue leaves it) and
+// 17 exit2.
+class MipsSimulator {
+public:
+    static const uint32_t kMemoryBytes = 32u << 20;
+    // Generated code keeps its operand stack just below the initial $sp,
+    // growing upwards; recursion deeper than it was sized for carries on
+    // past it, so some memory is left above
+    static const uint32_t kStackTop = kMemoryBytes - (1u << 20);
+
+    MipsSimulator();
+
+    // One instruction word per line, as MipsAssembler::assemble() writes it
+    void loadHex(const std::string& filename);
+    // Raw big-endian instruction words
+    void loadBinary(const std::string& filename);
+    void load(const std::vector<uint32_t>& words);
+
+    // Stops run() with an error after this many instructions; 0 means no
+    // limit
+    void setInstructionLimit(uint64_t limit);
+
+    // Drives a MipsTiming model during run(); without this the timing hooks
+    // are compiled out of the loop
+    void enableTiming(const MipsCacheConfig& icache, const MipsCacheConfig& dcache);
+    const MipsTiming& getTiming() const;
+
+    void run();
+
+    int32_t getExitCode() const;
+    uint64_t getRetiredCount() const;
+    uint32_t getRegister(int reg) const;
+
+private:
+    enum class Op : uint8_t {
+        NOP, ADD, ADDU, SUB, AND, OR, XOR, NOR, SLT, SLTU,
+        SUBU, SLL, SRL, SRA, MULT, DIV, MFLO, MFHI, JR, JALR, SYSCALL, BREAK,
+        ADDI, ADDIU, ANDI, ORI, XORI, SLTI, SLTIU, LUI,
+        LW, SW, LB, SB, BEQ, BNE, BLEZ, BGTZ, BLTZ, BGEZ, J, JAL,
+        INVALID, // faults when executed; `imm` holds the word
+    };
+
+    // Register fields are register numbers, except that a destination of
+    // $zero becomes kScratch so no instruction needs a special case for it.
+    // `imm` is already sign- or zero-extended as the opcode requires;
+    // branch and jump targets are indices into `code`.
+    struct Decoded {
+        Op op;
+        uint8_t rs;
+        uint8_t rt;
+        uint8_t rd;
+        int32_t imm;
+    };
+    static const int kScratch = 32;
+
+    Decoded decode(uint32_t word, uint32_t index) const;
+    template <bool Timed> void execute();
+    void syscall();
+    uint8_t* at(uint32_t addr, uint32_t bytes);
+
+    std::vector<uint32_t> text;     // as loaded, for the timing model
+    std::vector<Decoded> code;
+    std::vector<uint8_t> memory;
+    uint32_t regs[33];
+    uint32_t lo;
+    uint32_t hi;
+    uint32_t heap_break;
+    bool exited;
+    int32_t exit_code;
+    uint64_t retired;
+    uint64_t limit;
+    bool timed;
+    MipsTiming timing;
+};
+
+#endif
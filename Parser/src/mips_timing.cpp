@@ -0,0 +1,257 @@
+#include "mips_timing.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+double percent(uint64_t part, uint64_t whole) {
+    return whole ? 100.0 * static_cast<double>(part) / static_cast<double>(whole) : 0.0;
+}
+
+double ratio(uint64_t part, uint64_t whole) {
+    return whole ? static_cast<double>(part) / static_cast<double>(whole) : 0.0;
+}
+
+uint32_t log2Of(uint32_t value) {
+    uint32_t shift = 0;
+    while ((1u << shift) < value) ++shift;
+    return shift;
+}
+
+std::string functionName(uint32_t addr) {
+    std::ostringstream out;
+    out << "func@0x" << std::hex << std::setw(8) << std::setfill('0') << addr;
+    return out.str();
+}
+
+} // namespace
+
+MipsCacheConfig parseCacheConfig(const std::string& text) {
+    auto powerOfTwo = [](unsigned long v) { return v != 0 && (v & (v - 1)) == 0; };
+    size_t colon = text.find(':');
+    unsigned long size = 0;
+    unsigned long line = 0;
+    try {
+        if (colon != std::string::npos) {
+            size = std::stoul(text.substr(0, colon));
+            line = std::stoul(text.substr(colon + 1));
+        }
+    } catch (const std::exception&) {
+        size = line = 0;
+    }
+    if (!powerOfTwo(size) || !powerOfTwo(line) || line < 4 || line > size || size > (1ul << 24)) {
+        throw std::runtime_error("Bad cache geometry '" + text + "', expected SIZE:LINE in bytes, e.g. 4096:16");
+    }
+    return MipsCacheConfig{static_cast<uint32_t>(size), static_cast<uint32_t>(line)};
+}
+
+void MipsTiming::Cache::reset(const MipsCacheConfig& geometry) {
+    config = geometry;
+    penalty = kMemoryLatency + geometry.line_bytes / 4;
+    line_shift = log2Of(geometry.line_bytes);
+    tags.assign(geometry.size_bytes / geometry.line_bytes, ~0u);
+}
+
+bool MipsTiming::Cache::lookup(uint32_t addr, bool allocate) {
+    uint32_t line = addr >> line_shift;
+    uint32_t& tag = tags[line & (tags.size() - 1)];
+    if (tag == line) return true;
+    if (allocate) tag = line;
+    return false;
+}
+
+MipsTiming::MipsTiming() {
+    configure(MipsCacheConfig{4096, 16}, MipsCacheConfig{4096, 16});
+    reset(std::vector<uint32_t>());
+}
+
+void MipsTiming::configure(const MipsCacheConfig& icache_geometry, const MipsCacheConfig& dcache_geometry) {
+    icache.reset(icache_geometry);
+    dcache.reset(dcache_geometry);
+}
+
+MipsTiming::Info MipsTiming::classify(uint32_t word) {
+    uint8_t rs = (word >> 21) & 31;
+    uint8_t rt = (word >> 16) & 31;
+    uint8_t rd = (word >> 11) & 31;
+    switch (word >> 26) {
+        case 0x00:
+            switch (word & 63) {
+                case 0x00: case 0x02: case 0x03:                // sll, srl, sra
+                    return Info{word == 0 ? kNop : kOther, rt, 0, rd};
+                case 0x0D: return Info{kOther, 0, 0, 0};         // break
+                case 0x08: return Info{kBranch, rs, 0, 0};   // jr
+                case 0x09: return Info{kBranch, rs, 0, rd};  // jalr
+                case 0x0C: return Info{kOther, 2, 4, 2};     // syscall reads $v0/$a0, sbrk writes $v0
+                case 0x10: case 0x12: return Info{kMflo, 0, 0, rd}; // mfhi, mflo
+                case 0x18: return Info{kMult, rs, rt, 0};
+                case 0x1A: return Info{kDiv, rs, rt, 0};
+                default: return Info{kOther, rs, rt, rd};
+            }
+        case 0x02: return Info{kBranch, 0, 0, 0};
+        case 0x03: return Info{kBranch, 0, 0, 31};
+        case 0x01: case 0x06: case 0x07: return Info{kBranch, rs, 0, 0}; // bltz/bgez, blez, bgtz
+        case 0x04: case 0x05: return Info{kBranch, rs, rt, 0};
+        case 0x0F: return Info{kOther, 0, 0, rt};        // lui
+        case 0x20: case 0x23: return Info{kLoad, rs, 0, rt};
+        case 0x28: case 0x2B: return Info{kStore, rs, rt, 0};
+        default: return Info{kOther, rs, 0, rt};         // immediate ALU ops
+    }
+}
+
+void MipsTiming::reset(const std::vector<uint32_t>& text) {
+    info.clear();
+    info.reserve(text.size());
+    for (uint32_t word : text) info.push_back(classify(word));
+
+    std::vector<uint32_t> starts(1, 0);
+    std::vector<std::string> names(1, "_start");
+    for (uint32_t i = 0; i < text.size(); ++i) {
+        uint32_t op = text[i] >> 26;
+        if ((op == 0x02 && i == 0) || op == 0x03) {
+            uint32_t target = (((i + 1) * 4) & 0xF0000000u) | ((text[i] & 0x03FFFFFFu) << 2);
+            if (std::find(starts.begin(), starts.end(), target) != starts.end()) continue;
+            starts.push_back(target);
+            names.push_back(op == 0x02 ? "main" : functionName(target));
+        }
+    }
+    functions.clear();
+    for (size_t f = 0; f < starts.size(); ++f) {
+        functions.push_back(Function{starts[f], names[f], 0, 0, 0, 0, 0});
+    }
+    std::sort(functions.begin(), functions.end(), [](const Function& a, const Function& b) { return a.start < b.start; });
+    function_of.assign(text.size(), 0);
+    for (uint32_t i = 0, f = 0; i < text.size(); ++i) {
+        while (f + 1 < functions.size() && functions[f + 1].start <= i * 4) ++f;
+        function_of[i] = f;
+    }
+
+    icache.reset(icache.config);
+    dcache.reset(dcache.config);
+    cycles = 0;
+    instructions = 0;
+    hilo_ready = 0;
+    previous_kind = kOther;
+    previous_load_dest = 0;
+    current = functions.data();
+    load_use_stalls = 0;
+    hilo_stalls = 0;
+    icache_stalls = 0;
+    dcache_stalls = 0;
+    stores = 0;
+    branches = 0;
+    branch_slot_nops = 0;
+    loads = 0;
+    load_slot_nops = 0;
+}
+
+void MipsTiming::charge(uint64_t cycles_spent) {
+    cycles += cycles_spent;
+    current->cycles += cycles_spent;
+}
+
+void MipsTiming::step(uint32_t index) {
+    const Info& in = info[index];
+    current = &functions[function_of[index]];
+    ++current->instructions;
+    ++instructions;
+
+    if (!icache.lookup(index * 4, true)) {
+        icache_stalls += icache.penalty;
+        ++current->fetch_misses;
+        charge(icache.penalty);
+    }
+    if (previous_load_dest != 0 && (in.src1 == previous_load_dest || in.src2 == previous_load_dest)) {
+        ++load_use_stalls;
+        charge(1);
+    }
+    if ((in.kind == kMflo || in.kind == kMult || in.kind == kDiv) && hilo_ready > cycles) {
+        hilo_stalls += hilo_ready - cycles;
+        charge(hilo_ready - cycles);
+    }
+    if (in.kind == kNop) {
+        if (previous_kind == kBranch) ++branch_slot_nops;
+        if (previous_kind == kLoad) ++load_slot_nops;
+    }
+    if (in.kind == kBranch) ++branches;
+    charge(1);
+    if (in.kind == kMult) hilo_ready = cycles + kMultLatency;
+    if (in.kind == kDiv) hilo_ready = cycles + kDivLatency;
+
+    previous_kind = in.kind;
+    previous_load_dest = in.kind == kLoad ? in.dest : 0;
+}
+
+void MipsTiming::load(uint32_t addr) {
+    ++loads;
+    ++current->loads;
+    if (!dcache.lookup(addr, true)) {
+        dcache_stalls += dcache.penalty;
+        ++current->load_misses;
+        charge(dcache.penalty);
+    }
+}
+
+void MipsTiming::store(uint32_t addr) {
+    ++stores;
+    dcache.lookup(addr, false); // write-through: a hit updates the line, a miss goes around it
+}
+
+uint64_t MipsTiming::getCycles() const {
+    return cycles;
+}
+
+uint64_t MipsTiming::getInstructions() const {
+    return instructions;
+}
+
+void MipsTiming::writeReport(std::ostream& out) const {
+    uint64_t fetch_misses = 0;
+    uint64_t load_misses = 0;
+    for (const Function& f : functions) {
+        fetch_misses += f.fetch_misses;
+        load_misses += f.load_misses;
+    }
+    uint64_t stalls = load_use_stalls + hilo_stalls + icache_stalls + dcache_stalls;
+
+    out << std::fixed << std::setprecision(2);
+    out << "--- R3000 Timing ---\n";
+    out << "Instructions: " << instructions << "\n";
+    out << "Cycles: " << cycles << "\n";
+    out << "CPI: " << ratio(cycles, instructions) << "\n";
+    out << "I-cache: " << icache.config.size_bytes << " B direct-mapped, " << icache.config.line_bytes << " B lines, "
+        << fetch_misses << " misses in " << instructions << " fetches (" << percent(fetch_misses, instructions) << "%)\n";
+    out << "D-cache: " << dcache.config.size_bytes << " B direct-mapped, " << dcache.config.line_bytes << " B lines, "
+        << load_misses << " misses in " << loads << " loads (" << percent(load_misses, loads) << "%), "
+        << stores << " stores written through\n";
+
+    out << "\nStall cycles by cause:\n";
+    out << std::right << std::setw(14) << "cycles" << std::setw(8) << "%" << "  cause\n";
+    const std::pair<uint64_t, const char*> causes[] = {
+        {load_use_stalls, "load-use"},
+        {hilo_stalls, "HI/LO wait (mult/div)"},
+        {icache_stalls, "I-cache miss"},
+        {dcache_stalls, "D-cache miss"},
+    };
+    for (const auto& c : causes) {
+        out << std::setw(14) << c.first << std::setw(7) << percent(c.first, cycles) << "%  " << c.second << "\n";
+    }
+    out << std::setw(14) << stalls << std::setw(7) << percent(stalls, cycles) << "%  total\n";
+
+    out << "\nDelay slots holding a nop:\n";
+    out << std::setw(14) << branch_slot_nops << " of " << branches << " branch delay slots\n";
+    out << std::setw(14) << load_slot_nops << " of " << loads << " load delay slots\n";
+
+    out << "\nPer function:\n";
+    out << std::setw(14) << "instructions" << std::setw(14) << "cycles" << std::setw(8) << "CPI"
+        << std::setw(9) << "I-miss" << std::setw(9) << "D-miss" << "  function\n";
+    for (const Function& f : functions) {
+        if (f.instructions == 0) continue;
+        out << std::setw(14) << f.instructions << std::setw(14) << f.cycles << std::setw(8) << ratio(f.cycles, f.instructions)
+            << std::setw(8) << percent(f.fetch_misses, f.instructions) << "%"
+            << std::setw(8) << percent(f.load_misses, f.loads) << "%  " << f.name << "\n";
+    }
+    out.unsetf(std::ios::floatfield);
+}
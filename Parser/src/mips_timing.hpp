@@ -0,0 +1,114 @@
+#ifndef MIPS_TIMING_HPP
+#define MIPS_TIMING_HPP
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Geometry of one direct-mapped cache; both sizes are powers of two
+struct MipsCacheConfig {
+    uint32_t size_bytes;
+    uint32_t line_bytes;
+};
+
+// Parses "SIZE:LINE" in bytes, e.g. "4096:16"; throws std::runtime_error
+// unless both are powers of two with 4 <= LINE <= SIZE
+MipsCacheConfig parseCacheConfig(const std::string& text);
+
+// Cycle-approximate R3000 timing, driven by MipsSimulator as it retires
+// instructions. Every instruction issues in one cycle, plus:
+// - a load-use stall when an instruction reads the register the previous
+//   one loaded (the R3000 load delay slot, counted as an interlock),
+// - waits for HI/LO when mflo, mult or div issues before an earlier
+//   mult (kMultLatency) or div (kDivLatency) has finished,
+// - a refill of kMemoryLatency cycles plus one per word on an I-cache miss
+//   or a D-cache load miss. The D-cache is write-through without write
+//   allocate, behind a write buffer that never fills.
+// Branch and load delay slots that hold a nop are counted separately: they
+// cost their issue cycle but do no work.
+//
+// Functions are found statically from the text: address 0, the target of
+// a leading `j` (main) and every jal target. Each instruction is charged to
+// the nearest function start at or before it.
+class MipsTiming {
+public:
+    static const uint32_t kMultLatency = 12;
+    static const uint32_t kDivLatency = 35;
+    static const uint32_t kMemoryLatency = 4;
+
+    MipsTiming();
+
+    void configure(const MipsCacheConfig& icache, const MipsCacheConfig& dcache);
+    // Clears the counters and classifies every instruction word
+    void reset(const std::vector<uint32_t>& text);
+
+    // Instruction `index` of the text issues
+    void step(uint32_t index);
+    // The instruction just stepped accesses data memory
+    void load(uint32_t addr);
+    void store(uint32_t addr);
+
+    uint64_t getCycles() const;
+    uint64_t getInstructions() const;
+
+    void writeReport(std::ostream& out) const;
+
+private:
+    enum Kind : uint8_t { kOther, kNop, kLoad, kStore, kBranch, kMult, kDiv, kMflo };
+
+    struct Info {
+        Kind kind;
+        uint8_t src1; // 0 when unused: $zero never stalls anything
+        uint8_t src2;
+        uint8_t dest;
+    };
+
+    struct Cache {
+        MipsCacheConfig config;
+        uint32_t penalty;
+        uint32_t line_shift;
+        std::vector<uint32_t> tags; // line address per set, ~0 when empty
+
+        void reset(const MipsCacheConfig& geometry);
+        bool lookup(uint32_t addr, bool allocate);
+    };
+
+    struct Function {
+        uint32_t start; // byte address
+        std::string name;
+        uint64_t instructions;
+        uint64_t cycles;
+        uint64_t fetch_misses;
+        uint64_t loads;
+        uint64_t load_misses;
+    };
+
+    static Info classify(uint32_t word);
+    void charge(uint64_t cycles_spent);
+
+    std::vector<Info> info;
+    std::vector<uint32_t> function_of; // per instruction index
+    std::vector<Function> functions;
+    Cache icache;
+    Cache dcache;
+
+    uint64_t cycles;
+    uint64_t instructions;
+    uint64_t hilo_ready; // cycle at which a pending mult/div result is in HI/LO
+    Kind previous_kind;
+    uint8_t previous_load_dest;
+    Function* current;
+
+    uint64_t load_use_stalls;
+    uint64_t hilo_stalls;
+    uint64_t icache_stalls;
+    uint64_t dcache_stalls;
+    uint64_t stores;
+    uint64_t branches;
+    uint64_t branch_slot_nops;
+    uint64_t loads;
+    uint64_t load_slot_nops;
+};
+
+#endif
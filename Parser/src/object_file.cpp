@@ -0,0 +1,140 @@
+#include "object_file.hpp"
+#include "control_flow.hpp"
+#include <fstream>
+#include <map>
+#include <stdexcept>
+
+namespace {
+
+// Converts two hex chars (e.g., '4', 'F') to a single byte (0x4F)
+uint8_t hex_to_byte(char hi, char lo) {
+    auto char_to_val = [](char c) -> uint8_t {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        throw std::runtime_error("Invalid hex character in input file.");
+    };
+    return (char_to_val(hi) << 4) | char_to_val(lo);
+}
+
+// Reads a 4-byte little-endian integer from a byte vector
+uint32_t read_le32(const std::vector<uint8_t>& bytes, size_t offset) {
+    if (offset + 4 > bytes.size()) {
+        throw std::runtime_error("Attempted to read beyond byte vector boundaries.");
+    }
+    uint32_t value = 0;
+    value |= static_cast<uint32_t>(bytes[offset + 0]);
+    value |= static_cast<uint32_t>(bytes[offset + 1]) << 8;
+    value |= static_cast<uint32_t>(bytes[offset + 2]) << 16;
+    value |= static_cast<uint32_t>(bytes[offset + 3]) << 24;
+    return value;
+}
+
+} // namespace
+
+std::vector<uint8_t> readHexBytes(const std::string& filename) {
+    std::ifstream file(filename); // Open as text
+    if (!file.is_open()) {
+        throw std::runtime_error("Cannot open text file: " + filename);
+    }
+
+    std::vector<uint8_t> bytes;
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t comment_pos = line.find("//");
+        if (comment_pos != std::string::npos) {
+            line = line.substr(0, comment_pos);
+        }
+        char hi = 0;
+        for (char c : line) {
+            if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F')) {
+                if (hi == 0) {
+                    hi = c;
+                } else {
+                    bytes.push_back(hex_to_byte(hi, c));
+                    hi = 0;
+                }
+            }
+        }
+        if (hi != 0) {
+            throw std::runtime_error("Found an odd number of hex digits on a line.");
+        }
+    }
+    return bytes;
+}
+
+ObjectFile parseObjectFile(const std::vector<uint8_t>& bytes) {
+    if (bytes.size() < 20) {
+        throw std::runtime_error("File is too small to contain a valid header.");
+    }
+    uint64_t code_section_size = read_le32(bytes, 4);
+    uint64_t data_section_size = read_le32(bytes, 8);
+    uint64_t symbol_table_size = read_le32(bytes, 12);
+    if (20 + code_section_size + data_section_size + symbol_table_size > bytes.size()) {
+        throw std::runtime_error("Section sizes in the header run past the end of the file.");
+    }
+
+    ObjectFile object;
+    auto section = bytes.begin() + 20;
+    object.code.assign(section, section + code_section_size);
+    section += code_section_size;
+    object.data.assign(section, section + data_section_size);
+    section += data_section_size;
+    object.symbol_table_size = static_cast<uint32_t>(symbol_table_size);
+    std::vector<uint8_t> symbol_table_bytes(section, section + symbol_table_size);
+
+    size_t st_offset = 0;
+    uint32_t symbol_count = read_le32(symbol_table_bytes, st_offset);
+    st_offset += 4;
+    for (uint32_t i = 0; i < symbol_count; ++i) {
+        SymbolEntry entry;
+        uint32_t name_len = read_le32(symbol_table_bytes, st_offset);
+        st_offset += 4;
+        if (st_offset + name_len + 3 > symbol_table_bytes.size()) {
+            throw std::runtime_error("Attempted to read beyond byte vector boundaries.");
+        }
+        entry.name = std::string(reinterpret_cast<const char*>(symbol_table_bytes.data() + st_offset), name_len);
+        st_offset += name_len;
+        entry.type = symbol_table_bytes[st_offset++];
+        entry.binding = symbol_table_bytes[st_offset++];
+        entry.defined = symbol_table_bytes[st_offset++];
+        entry.address = read_le32(symbol_table_bytes, st_offset);
+        st_offset += 4;
+        object.symbols.push_back(entry);
+    }
+    return object;
+}
+
+std::vector<Instruction> insertSymbolLabels(const std::vector<Instruction>& instructions,
+                                            const std::vector<SymbolEntry>& symbols) {
+    // Symbols by their byte address; only defined ones name code
+    std::map<uint32_t, std::vector<SymbolEntry>> symbols_by_address;
+    for (const auto& sym : symbols) {
+        if (sym.defined) {
+            symbols_by_address[sym.address].push_back(sym);
+        }
+    }
+
+    std::vector<Instruction> processed_instructions;
+    uint32_t current_bytes = 0;
+    for (const auto& instr : instructions) {
+        auto at = symbols_by_address.find(current_bytes);
+        if (at != symbols_by_address.end()) {
+            for (const auto& sym : at->second) {
+                Instruction new_label_instr;
+                if (sym.name == "kik" || sym.name == "main") {
+                    new_label_instr.name = "main:";
+                } else if (sym.binding == 1) { // 1 = GLOBAL
+                    new_label_instr.name = ".global";
+                }
+                if (!new_label_instr.name.empty()) {
+                    processed_instructions.push_back(new_label_instr);
+                }
+            }
+        }
+        processed_instructions.push_back(instr);
+
+        current_bytes += encodedSize(instr.name);
+    }
+    return processed_instructions;
+}
@@ -0,0 +1,31 @@
+#ifndef OBJECT_FILE_HPP
+#define OBJECT_FILE_HPP
+
+#include "parser.hpp"
+#include "symbol_table.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A .o file as the front end reads it: a 20-byte header whose words at
+// offsets 4, 8 and 12 are the little-endian sizes of the code, data and
+// symbol sections, followed by those sections.
+struct ObjectFile {
+    std::vector<uint8_t> code;
+    std::vector<uint8_t> data;
+    std::vector<SymbolEntry> symbols;
+    uint32_t symbol_table_size; // bytes, as in the header
+};
+
+// The bytes of a hex text file: pairs of hex digits, anything after `//`
+// on a line ignored. Throws std::runtime_error on an odd digit count.
+std::vector<uint8_t> readHexBytes(const std::string& filename);
+
+ObjectFile parseObjectFile(const std::vector<uint8_t>& bytes);
+
+// Inserts the "main:" and ".global" pseudo-instructions that the simulator
+// and the generator expect before the instructions symbols point at
+std::vector<Instruction> insertSymbolLabels(const std::vector<Instruction>& instructions,
+                                            const std::vector<SymbolEntry>& symbols);
+
+#endif
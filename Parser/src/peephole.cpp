@@ -0,0 +1,249 @@
+#include "peephole.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+const size_t npos = static_cast<size_t>(-1);
+
+// The code with the instructions the rules removed marked dead
+struct Lines {
+    std::vector<MipsInstruction>& code;
+    std::vector<bool> dead;
+};
+
+// Next live label or instruction after `p`
+size_t nextEntry(const Lines& lines, size_t p) {
+    for (size_t q = p + 1; q < lines.code.size(); ++q) {
+        if (!lines.dead[q] && lines.code[q].op != MipsOp::COMMENT) return q;
+    }
+    return npos;
+}
+
+bool inDelaySlot(const Lines& lines, size_t p) {
+    for (size_t q = p; q-- > 0;) {
+        if (!lines.dead[q] && isCode(lines.code[q].op)) return isBranch(lines.code[q].op);
+    }
+    return false;
+}
+
+// Next instruction that runs exactly when `p` does and right after it:
+// none past a label, after a branch or after a delay slot
+size_t next(const Lines& lines, size_t p) {
+    if (isBranch(lines.code[p].op) || inDelaySlot(lines, p)) return npos;
+    size_t q = nextEntry(lines, p);
+    return (q != npos && isCode(lines.code[q].op)) ? q : npos;
+}
+
+bool selfMove(Lines& lines, size_t p) {
+    const MipsInstruction& instr = lines.code[p];
+    bool self = false;
+    if (instr.op == MipsOp::ADDIU) {
+        self = instr.rt == instr.rs && instr.imm == 0;
+    } else if (instr.op == MipsOp::ADDU || instr.op == MipsOp::OR) {
+        self = (instr.rd == instr.rs && instr.rt == kZero) || (instr.rd == instr.rt && instr.rs == kZero);
+    }
+    if (!self || inDelaySlot(lines, p)) return false;
+    lines.dead[p] = true;
+    return true;
+}
+
+bool addiuChain(Lines& lines, size_t p) {
+    MipsInstruction& first = lines.code[p];
+    if (first.op != MipsOp::ADDIU) return false;
+    const int d = first.rt;
+    const int s = first.rs;
+    for (size_t q = next(lines, p); q != npos; q = next(lines, q)) {
+        const MipsInstruction& instr = lines.code[q];
+        if (instr.op == MipsOp::ADDIU && instr.rt == d && instr.rs == d) {
+            int64_t sum = static_cast<int64_t>(first.imm) + instr.imm;
+            if (sum < -32768 || sum > 32767) return false;
+            first.imm = static_cast<int32_t>(sum);
+            lines.dead[q] = true;
+            return true;
+        }
+        if (readsRegister(instr, d) || writesRegister(instr, d) || writesRegister(instr, s)) return false;
+    }
+    return false;
+}
+
+bool recompute(Lines& lines, size_t p) {
+    const MipsInstruction& first = lines.code[p];
+    int dest = destination(first);
+    if (!isPure(first.op) || dest < 0 || readsRegister(first, dest)) return false;
+    for (size_t q = next(lines, p); q != npos; q = next(lines, q)) {
+        const MipsInstruction& instr = lines.code[q];
+        if (sameInstruction(instr, first)) {
+            lines.dead[q] = true;
+            return true;
+        }
+        int written = destination(instr);
+        if (isBarrier(instr.op) || written == dest || (written >= 0 && readsRegister(first, written))) return false;
+    }
+    return false;
+}
+
+// Whether `store` may write the word at `offset`(`base`). Frame slots are
+// reached only through $sp, heap and operand stack words only through
+// other registers.
+bool mayOverwrite(const MipsInstruction& store, int base, int32_t offset) {
+    if (!isStore(store.op)) return false;
+    if ((store.rs == kSp) != (base == kSp)) return false;
+    return base != kSp || (store.imm & ~3) == offset;
+}
+
+bool storeLoad(Lines& lines, size_t p) {
+    const MipsInstruction& store = lines.code[p];
+    if (store.op != MipsOp::SW) return false;
+    for (size_t q = next(lines, p); q != npos; q = next(lines, q)) {
+        MipsInstruction& instr = lines.code[q];
+        if (instr.op == MipsOp::LW && instr.rs == store.rs && instr.imm == store.imm) {
+            if (instr.rt == store.rt) {
+                lines.dead[q] = true;
+            } else {
+                instr = mipsR(MipsOp::ADDU, instr.rt, store.rt, kZero);
+            }
+            return true;
+        }
+        if (mayOverwrite(instr, store.rs, store.imm) || writesRegister(instr, store.rt) || writesRegister(instr, store.rs)) {
+            return false;
+        }
+    }
+    return false;
+}
+
+bool loadLoad(Lines& lines, size_t p) {
+    const MipsInstruction& load = lines.code[p];
+    if (load.op != MipsOp::LW || load.rt == load.rs) return false;
+    for (size_t q = next(lines, p); q != npos; q = next(lines, q)) {
+        MipsInstruction& instr = lines.code[q];
+        if (instr.op == MipsOp::LW && instr.rs == load.rs && instr.imm == load.imm) {
+            if (instr.rt == load.rt) {
+                lines.dead[q] = true;
+            } else {
+                instr = mipsR(MipsOp::ADDU, instr.rt, load.rt, kZero);
+            }
+            return true;
+        }
+        if (mayOverwrite(instr, load.rs, load.imm) || writesRegister(instr, load.rt) || writesRegister(instr, load.rs)) {
+            return false;
+        }
+    }
+    return false;
+}
+
+bool jumpNext(Lines& lines, size_t p) {
+    const MipsInstruction& jump = lines.code[p];
+    if (jump.op != MipsOp::J && !isConditionalBranch(jump.op)) return false;
+    if (inDelaySlot(lines, p)) return false;
+    size_t slot = nextEntry(lines, p);
+    if (slot == npos || lines.code[slot].op != MipsOp::NOP) return false;
+    for (size_t q = nextEntry(lines, slot); q != npos && lines.code[q].op == MipsOp::LABEL; q = nextEntry(lines, q)) {
+        if (lines.code[q].label == jump.label) {
+            lines.dead[p] = true;
+            lines.dead[slot] = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+const struct {
+    const char* name;
+    bool (*apply)(Lines& lines, size_t p);
+} kRules[] = {
+    {"self-move", selfMove},
+    {"addiu-chain", addiuChain},
+    {"recompute", recompute},
+    {"store-load", storeLoad},
+    {"load-load", loadLoad},
+    {"jump-next", jumpNext},
+};
+const size_t kRuleCount = sizeof(kRules) / sizeof(kRules[0]);
+
+size_t countInstructions(const Lines& lines) {
+    size_t count = 0;
+    for (size_t p = 0; p < lines.code.size(); ++p) {
+        if (isCode(lines.code[p].op) && !lines.dead[p]) ++count;
+    }
+    return count;
+}
+
+} // namespace
+
+const std::vector<std::string>& PeepholeOptimizer::ruleNames() {
+    static const std::vector<std::string> names = [] {
+        std::vector<std::string> result;
+        for (const auto& rule : kRules) result.push_back(rule.name);
+        return result;
+    }();
+    return names;
+}
+
+PeepholeOptimizer::PeepholeOptimizer()
+    : enabled(kRuleCount, true), hits(kRuleCount, 0), instructions_before(0), instructions_after(0) {}
+
+void PeepholeOptimizer::setRules(const std::string& rule_list) {
+    std::vector<bool> wanted(kRuleCount, false);
+    std::stringstream ss(rule_list);
+    std::string name;
+    while (std::getline(ss, name, ',')) {
+        if (name.empty()) continue;
+        const std::vector<std::string>& names = ruleNames();
+        auto it = std::find(names.begin(), names.end(), name);
+        if (it == names.end()) throw std::runtime_error("Unknown peephole rule: " + name);
+        wanted[it - names.begin()] = true;
+    }
+    enabled = wanted;
+}
+
+void PeepholeOptimizer::optimize(std::vector<MipsInstruction>& code) {
+    Lines lines{code, std::vector<bool>(code.size(), false)};
+
+    std::fill(hits.begin(), hits.end(), 0);
+    instructions_before = countInstructions(lines);
+    // A rewrite can expose another match earlier in the code, so passes
+    // repeat until one changes nothing
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t p = 0; p < code.size(); ++p) {
+            for (size_t r = 0; r < kRuleCount; ++r) {
+                if (lines.dead[p] || !isCode(code[p].op)) break;
+                if (enabled[r] && kRules[r].apply(lines, p)) {
+                    ++hits[r];
+                    changed = true;
+                }
+            }
+        }
+    }
+    instructions_after = countInstructions(lines);
+
+    size_t kept = 0;
+    for (size_t p = 0; p < code.size(); ++p) {
+        if (!lines.dead[p]) code[kept++] = code[p];
+    }
+    code.resize(kept);
+}
+
+size_t PeepholeOptimizer::getInstructionsBefore() const {
+    return instructions_before;
+}
+
+size_t PeepholeOptimizer::getInstructionsAfter() const {
+    return instructions_after;
+}
+
+const std::vector<size_t>& PeepholeOptimizer::getRuleHits() const {
+    return hits;
+}
+
+void PeepholeOptimizer::writeReport(std::ostream& out) const {
+    out << "Peephole: " << instructions_before << " -> " << instructions_after << " instructions ("
+        << instructions_before - instructions_after << " saved)\n";
+    for (size_t r = 0; r < kRuleCount; ++r) {
+        out << std::setw(14) << hits[r] << "  " << kRules[r].name << (enabled[r] ? "" : " (disabled)") << "\n";
+    }
+}
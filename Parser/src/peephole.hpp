@@ -0,0 +1,55 @@
+#ifndef PEEPHOLE_HPP
+#define PEEPHOLE_HPP
+
+#include "mips_instruction.hpp"
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Rewrites the generator's code before it is assembled. Rules look at
+// straight-line code only: a window never crosses a label and never
+// reaches past a branch, and an instruction in a branch delay slot is
+// never removed. The rules, in the order they are tried:
+//   self-move     addiu r, r, 0 / addu/or r, r, $zero              -> removed
+//   addiu-chain   addiu d, s, a ... addiu d, d, b                  -> addiu d, s, a+b
+//   recompute     an ALU result computed again from unchanged
+//                 operands                                        -> second one removed
+//   store-load    sw r, k(b) ... lw c, k(b)                        -> addu c, r, $zero
+//   load-load     lw r, k(b) ... lw c, k(b)                        -> addu c, r, $zero,
+//                                                                    removed when c is r
+//   jump-next     j or a conditional branch to L with a nop delay slot, directly
+//                 before L:                                       -> both removed
+// A store through $sp ends a store-load or load-load window only when it
+// writes the same word, one through another register only when the
+// window's base is not $sp: frame slots and heap words never overlap.
+// All rules are applied until none of them matches any more.
+class PeepholeOptimizer {
+public:
+    // Names of every rule, in the order they are tried
+    static const std::vector<std::string>& ruleNames();
+
+    PeepholeOptimizer(); // all rules enabled
+
+    // Enables only the rules in a comma-separated list of names ("" for
+    // none); throws std::runtime_error on an unknown name
+    void setRules(const std::string& rule_list);
+
+    // Rewrites `code` in place
+    void optimize(std::vector<MipsInstruction>& code);
+
+    size_t getInstructionsBefore() const;
+    size_t getInstructionsAfter() const;
+    // Hits per rule in the last optimize(), in ruleNames() order
+    const std::vector<size_t>& getRuleHits() const;
+
+    void writeReport(std::ostream& out) const;
+
+private:
+    std::vector<bool> enabled;
+    std::vector<size_t> hits;
+    size_t instructions_before;
+    size_t instructions_after;
+};
+
+#endif
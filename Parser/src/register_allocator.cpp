@@ -1,23 +1,64 @@
 #include "register_allocator.hpp"
+#include <algorithm>
 
-
-RegisterAllocator::RegisterAllocator() {
-    // Pool of available temporary registers ($t0-$t9)
-    available_registers = {"$t0", "$t1", "$t2", "$t3", "$t4", "$t5", "$t6"};
+RegisterAllocator::RegisterAllocator(const std::vector<std::string>& caller_saved, const std::vector<std::string>& callee_saved)
+    : registers(caller_saved), caller_saved_count(caller_saved.size()), callee_saved_used(callee_saved.size(), false) {
+    registers.insert(registers.end(), callee_saved.begin(), callee_saved.end());
 }
 
-// Get a free register from the pool
-std::string RegisterAllocator::acquire() {
-    if (available_registers.empty()) {
-        throw std::runtime_error("Compiler error: Out of temporary registers!");
+std::vector<std::string> RegisterAllocator::allocate(std::vector<LiveInterval> intervals, size_t vreg_count) {
+    std::sort(intervals.begin(), intervals.end(), [](const LiveInterval& a, const LiveInterval& b) {
+        return a.start != b.start ? a.start < b.start : a.vreg < b.vreg;
+    });
+
+    std::vector<int> assigned(vreg_count, -1); // index into `registers`
+    std::vector<bool> busy(registers.size(), false);
+    std::vector<const LiveInterval*> active;    // holding a register, by increasing end
+
+    for (const LiveInterval& current : intervals) {
+        while (!active.empty() && active.front()->end <= current.start) {
+            busy[assigned[active.front()->vreg]] = false;
+            active.erase(active.begin());
+        }
+
+        size_t first = current.crosses_call ? caller_saved_count : 0;
+        int reg = -1;
+        for (size_t r = first; r < registers.size() && reg < 0; ++r) {
+            if (!busy[r]) reg = static_cast<int>(r);
+        }
+        if (reg < 0) {
+            // Take the register of the active interval that ends last, if
+            // it outlives this one and its register suits this one
+            const LiveInterval* victim = nullptr;
+            for (const LiveInterval* a : active) {
+                if (static_cast<size_t>(assigned[a->vreg]) >= first) victim = a;
+            }
+            if (victim == nullptr || victim->end <= current.end) continue; // current stays spilled
+            reg = assigned[victim->vreg];
+            assigned[victim->vreg] = -1;
+            active.erase(std::find(active.begin(), active.end(), victim));
+        }
+
+        assigned[current.vreg] = reg;
+        busy[reg] = true;
+        active.insert(std::upper_bound(active.begin(), active.end(), &current,
+                                       [](const LiveInterval* a, const LiveInterval* b) { return a->end < b->end; }),
+                      &current);
     }
-    std::string reg = available_registers.back();
-    available_registers.pop_back();
-    return reg;
-}
 
-// Return a register to the pool when it's no longer needed
-void RegisterAllocator::release(const std::string& reg) {
-    available_registers.push_back(reg);
+    std::vector<std::string> result(vreg_count);
+    for (size_t v = 0; v < vreg_count; ++v) {
+        if (assigned[v] < 0) continue;
+        result[v] = registers[assigned[v]];
+        if (static_cast<size_t>(assigned[v]) >= caller_saved_count) callee_saved_used[assigned[v] - caller_saved_count] = true;
+    }
+    return result;
 }
 
+std::vector<std::string> RegisterAllocator::usedCalleeSaved() const {
+    std::vector<std::string> used;
+    for (size_t r = 0; r < callee_saved_used.size(); ++r) {
+        if (callee_saved_used[r]) used.push_back(registers[caller_saved_count + r]);
+    }
+    return used;
+}
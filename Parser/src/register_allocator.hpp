@@ -1,12 +1,40 @@
+#ifndef REGISTER_ALLOCATOR_HPP
+#define REGISTER_ALLOCATOR_HPP
+
+#include <cstddef>
 #include <string>
 #include <vector>
-#include <stdexcept>
+
+// Lifetime of one virtual register, in positions of the instruction list
+// being allocated: written at `start`, last read at `end`
+struct LiveInterval {
+    int vreg;
+    int start;
+    int end;
+    bool crosses_call; // live across a jal, so only a callee-saved register keeps it
+};
+
+// Linear-scan register allocation. Intervals are visited by start; an
+// interval whose last read is at or before the current start gives its
+// register back, so an instruction may write the register of an operand
+// it reads for the last time. When no register is free, whichever of the
+// current interval and the active ones ends last is spilled. Intervals
+// live across a call only get callee-saved registers; the others take a
+// caller-saved one first, since those cost nothing to use.
 class RegisterAllocator {
-    public:
-        RegisterAllocator();
-        std::string acquire();
-        void release(const std::string& reg);
+public:
+    RegisterAllocator(const std::vector<std::string>& caller_saved, const std::vector<std::string>& callee_saved);
+
+    // Register per vreg number below `vreg_count`, "" for a spilled vreg
+    // or one without an interval
+    std::vector<std::string> allocate(std::vector<LiveInterval> intervals, size_t vreg_count);
+    // Callee-saved registers handed out by any allocate() so far, in pool order
+    std::vector<std::string> usedCalleeSaved() const;
 
-    private:
-        std::vector<std::string> available_registers;
+private:
+    std::vector<std::string> registers; // caller-saved first
+    size_t caller_saved_count;
+    std::vector<bool> callee_saved_used;
 };
+
+#endif
@@ -0,0 +1,231 @@
+#include "scheduler.hpp"
+#include <algorithm>
+#include <iomanip>
+
+namespace {
+
+const size_t npos = static_cast<size_t>(-1);
+
+// Cycles from issue until the result can be used without a stall, as in
+// mips_timing.cpp
+const int kLoadLatency = 2;
+const int kMultLatency = 12;
+const int kDivLatency = 35;
+
+// An instruction with the comments that lead up to it
+struct Node {
+    std::vector<size_t> comments;
+    size_t line;
+};
+
+// Two accesses to the same base register with disjoint offsets cannot
+// overlap; any other pair with a store in it might. A base written in
+// between orders both accesses through its own register dependences.
+bool memoryConflict(const MipsInstruction& a, const MipsInstruction& b) {
+    bool a_memory = isLoad(a.op) || isStore(a.op);
+    bool b_memory = isLoad(b.op) || isStore(b.op);
+    if (!a_memory || !b_memory || (!isStore(a.op) && !isStore(b.op))) return false;
+    if (a.rs == b.rs) {
+        int64_t size_a = (a.op == MipsOp::LW || a.op == MipsOp::SW) ? 4 : 1;
+        int64_t size_b = (b.op == MipsOp::LW || b.op == MipsOp::SW) ? 4 : 1;
+        return a.imm < b.imm + size_b && b.imm < a.imm + size_a;
+    }
+    return true;
+}
+
+// Whether `b` must stay after `a`
+bool dependent(const MipsInstruction& a, const MipsInstruction& b) {
+    if (isBarrier(a.op) || isBarrier(b.op)) return true;
+    if (memoryConflict(a, b)) return true;
+    if ((writesHiLo(a.op) && (readsHiLo(b.op) || writesHiLo(b.op))) || (writesHiLo(b.op) && readsHiLo(a.op))) return true;
+    int da = destination(a);
+    int db = destination(b);
+    if (da >= 0 && (da == db || readsRegister(b, da))) return true;
+    return db >= 0 && readsRegister(a, db);
+}
+
+// Cycles `b` should issue after `a` when it depends on it
+int latency(const MipsInstruction& a, const MipsInstruction& b) {
+    if (isLoad(a.op) && readsRegister(b, a.rt)) return kLoadLatency;
+    if (readsHiLo(b.op)) {
+        if (a.op == MipsOp::MULT) return kMultLatency;
+        if (a.op == MipsOp::DIV) return kDivLatency;
+    }
+    return 1;
+}
+
+size_t countLoadUse(const std::vector<MipsInstruction>& code) {
+    size_t count = 0;
+    const MipsInstruction* previous = nullptr;
+    for (const MipsInstruction& instr : code) {
+        if (instr.op == MipsOp::LABEL) previous = nullptr;
+        if (!isCode(instr.op)) continue;
+        if (previous != nullptr && isLoad(previous->op) && previous->rt != kZero && readsRegister(instr, previous->rt)) {
+            ++count;
+        }
+        previous = &instr;
+    }
+    return count;
+}
+
+// List schedule of `body`: returns positions in `body`. `branch` (or
+// npos) ends the region; it stays last but counts toward the path lengths.
+std::vector<size_t> listSchedule(const std::vector<MipsInstruction>& lines, const std::vector<Node>& body, size_t branch) {
+    size_t n = body.size();
+    std::vector<std::vector<std::pair<size_t, int>>> successors(n);
+    std::vector<size_t> waiting(n, 0); // unscheduled predecessors
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = i + 1; j < n; ++j) {
+            const MipsInstruction& a = lines[body[i].line];
+            const MipsInstruction& b = lines[body[j].line];
+            if (dependent(a, b)) {
+                successors[i].push_back({j, latency(a, b)});
+                ++waiting[j];
+            }
+        }
+    }
+    // Longest latency-weighted path from each instruction to the region end
+    std::vector<int> height(n, 0);
+    for (size_t i = n; i-- > 0;) {
+        const MipsInstruction& a = lines[body[i].line];
+        if (branch != npos && dependent(a, lines[branch])) height[i] = latency(a, lines[branch]);
+        for (const auto& s : successors[i]) height[i] = std::max(height[i], s.second + height[s.first]);
+    }
+
+    std::vector<size_t> order;
+    std::vector<bool> done(n, false);
+    std::vector<int> earliest(n, 0);
+    int cycle = 0;
+    while (order.size() < n) {
+        // Prefer an instruction that can issue now, then the longest path,
+        // then the original order
+        size_t best = npos;
+        for (size_t i = 0; i < n; ++i) {
+            if (done[i] || waiting[i] > 0) continue;
+            if (best == npos) {
+                best = i;
+                continue;
+            }
+            bool ready = earliest[i] <= cycle;
+            bool best_ready = earliest[best] <= cycle;
+            if (ready != best_ready ? ready : height[i] > height[best]) best = i;
+        }
+        int issue = std::max(cycle, earliest[best]);
+        done[best] = true;
+        order.push_back(best);
+        cycle = issue + 1;
+        for (const auto& s : successors[best]) {
+            earliest[s.first] = std::max(earliest[s.first], issue + s.second);
+            --waiting[s.first];
+        }
+    }
+    return order;
+}
+
+} // namespace
+
+InstructionScheduler::InstructionScheduler()
+    : delay_slots(0), nops_eliminated(0), load_use_before(0), load_use_after(0) {}
+
+void InstructionScheduler::schedule(std::vector<MipsInstruction>& code) {
+    const std::vector<MipsInstruction> lines = code;
+    delay_slots = 0;
+    nops_eliminated = 0;
+    load_use_before = countLoadUse(lines);
+
+    std::vector<size_t> out; // indices into `lines`, in the new order
+    std::vector<Node> body;
+    std::vector<size_t> comments;
+
+    // Writes out `body`, then the branch ending the region and its delay
+    // slot with the comments between them (npos where there are none)
+    auto finishRegion = [&](size_t branch, const std::vector<size_t>& slot_comments, size_t slot) {
+        std::vector<size_t> order = listSchedule(lines, body, branch);
+        size_t filler = npos; // position in `order` that moves into the slot
+        if (slot != npos) {
+            ++delay_slots;
+            for (size_t k = order.size(); k-- > 0 && lines[slot].op == MipsOp::NOP && filler == npos;) {
+                const MipsInstruction& candidate = lines[body[order[k]].line];
+                if (isBarrier(candidate.op) || isBranch(candidate.op) || dependent(candidate, lines[branch])) continue;
+                bool free = true;
+                for (size_t later = k + 1; later < order.size() && free; ++later) {
+                    free = !dependent(candidate, lines[body[order[later]].line]);
+                }
+                if (free) filler = k;
+            }
+        }
+        for (size_t k = 0; k < order.size(); ++k) {
+            const Node& node = body[order[k]];
+            out.insert(out.end(), node.comments.begin(), node.comments.end());
+            if (k != filler) out.push_back(node.line);
+        }
+        out.insert(out.end(), comments.begin(), comments.end());
+        if (branch != npos) out.push_back(branch);
+        out.insert(out.end(), slot_comments.begin(), slot_comments.end());
+        if (filler != npos) {
+            out.push_back(body[order[filler]].line);
+            ++nops_eliminated;
+        } else if (slot != npos) {
+            out.push_back(slot);
+        }
+        body.clear();
+        comments.clear();
+    };
+
+    bool pinned = false; // the next instruction is the delay slot of a branch before a label
+    for (size_t p = 0; p < lines.size(); ++p) {
+        const MipsInstruction& line = lines[p];
+        if (line.op == MipsOp::LABEL) {
+            finishRegion(npos, {}, npos);
+            out.push_back(p);
+        } else if (line.op == MipsOp::COMMENT) {
+            comments.push_back(p);
+        } else if (pinned) {
+            finishRegion(npos, {}, npos);
+            out.push_back(p);
+            pinned = false;
+        } else if (!isBranch(line.op)) {
+            body.push_back(Node{comments, p});
+            comments.clear();
+        } else {
+            // The delay slot is the next instruction, unless a label comes
+            // first
+            std::vector<size_t> slot_comments;
+            size_t slot = p + 1;
+            while (slot < lines.size() && lines[slot].op == MipsOp::COMMENT) slot_comments.push_back(slot++);
+            if (slot < lines.size() && isCode(lines[slot].op)) {
+                finishRegion(p, slot_comments, slot);
+                p = slot;
+            } else {
+                finishRegion(p, {}, npos);
+                pinned = true;
+            }
+        }
+    }
+    finishRegion(npos, {}, npos);
+
+    code.clear();
+    for (size_t p : out) code.push_back(lines[p]);
+    load_use_after = countLoadUse(code);
+}
+
+size_t InstructionScheduler::getDelaySlots() const {
+    return delay_slots;
+}
+
+size_t InstructionScheduler::getNopsEliminated() const {
+    return nops_eliminated;
+}
+
+size_t InstructionScheduler::getLoadUseBefore() const {
+    return load_use_before;
+}
+
+size_t InstructionScheduler::getLoadUseAfter() const {
+    return load_use_after;
+}
+
+void InstructionScheduler::writeReport(std::ostream& out) const {
+    out << "Scheduler: " << nops_eliminated << " of " << delay_slots << " delay-slot nops eliminated, "
+        << load_use_before << " -> " << load_use_after << " load-use stalls" << std::endl;
+}
@@ -0,0 +1,42 @@
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+#include "mips_instruction.hpp"
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Reorders the generator's code for the R3000 pipeline, after the
+// peephole pass and before the assembler. Code is scheduled one region at
+// a time: the straight-line instructions between labels, up to and
+// including a branch and its delay slot. Within a region a list scheduler
+// keeps every register, HI/LO and memory dependence and picks, cycle by
+// cycle, the ready instruction with the longest latency-weighted path to
+// the end of the region, so loads move away from their first use and
+// mult/div away from mflo/mfhi. Then, when the branch's delay slot holds
+// a nop, the last instruction that neither the branch nor anything after
+// it depends on moves into the slot and the nop goes away. syscall and
+// break stay where they are, with nothing moved across them.
+class InstructionScheduler {
+public:
+    InstructionScheduler();
+
+    // Reorders `code` in place
+    void schedule(std::vector<MipsInstruction>& code);
+
+    size_t getDelaySlots() const;      // branch delay slots seen
+    size_t getNopsEliminated() const;  // delay-slot nops replaced by useful work
+    size_t getLoadUseBefore() const;   // loads directly followed by a use of the value
+    size_t getLoadUseAfter() const;
+
+    void writeReport(std::ostream& out) const;
+
+private:
+    size_t delay_slots;
+    size_t nops_eliminated;
+    size_t load_use_before;
+    size_t load_use_after;
+};
+
+#endif
@@ -0,0 +1,79 @@
+#include "superinstructions.hpp"
+#include <climits>
+
+int superinstructionLength(OpCode op) {
+    switch (op) {
+        case OpCode::IADD_K: case OpCode::ISUB_K:
+        case OpCode::ICMP_EQ_JF: case OpCode::ICMP_LT_JF: case OpCode::ICMP_GT_JF:
+        case OpCode::ICMP_EQ_JT: case OpCode::ICMP_LT_JT: case OpCode::ICMP_GT_JT:
+            return 2;
+        case OpCode::ILOAD2_IADD:
+            return 3;
+        case OpCode::IINC:
+            return 4;
+        default:
+            return 1;
+    }
+}
+
+OpCode unfusedOpcode(OpCode op) {
+    switch (op) {
+        case OpCode::IADD_K: case OpCode::ISUB_K: return OpCode::ICONST;
+        case OpCode::ILOAD2_IADD: case OpCode::IINC: return OpCode::ILOAD;
+        case OpCode::ICMP_EQ_JF: case OpCode::ICMP_EQ_JT: return OpCode::ICMP_EQ;
+        case OpCode::ICMP_LT_JF: case OpCode::ICMP_LT_JT: return OpCode::ICMP_LT;
+        case OpCode::ICMP_GT_JF: case OpCode::ICMP_GT_JT: return OpCode::ICMP_GT;
+        default: return op;
+    }
+}
+
+namespace {
+
+// Fused compare-and-branch for a compare at `cmp` followed by `branch`
+bool fuseCompareBranch(OpCode cmp, OpCode branch, OpCode& fused) {
+    bool on_false = (branch == OpCode::JMP_IF_FALSE);
+    if (!on_false && branch != OpCode::JNZ) return false;
+    switch (cmp) {
+        case OpCode::ICMP_EQ: fused = on_false ? OpCode::ICMP_EQ_JF : OpCode::ICMP_EQ_JT; return true;
+        case OpCode::ICMP_LT: fused = on_false ? OpCode::ICMP_LT_JF : OpCode::ICMP_LT_JT; return true;
+        case OpCode::ICMP_GT: fused = on_false ? OpCode::ICMP_GT_JF : OpCode::ICMP_GT_JT; return true;
+        default: return false;
+    }
+}
+
+} // namespace
+
+size_t fuseSuperinstructions(std::vector<DecodedInstr>& code) {
+    // Match against the unfused code so a rewrite never feeds the next match
+    const std::vector<DecodedInstr> original = code;
+    size_t sites = 0;
+
+    for (size_t i = 0; i + 1 < original.size(); ++i) {
+        const DecodedInstr& x = original[i];
+        const DecodedInstr& y = original[i + 1];
+        const DecodedInstr* z = (i + 2 < original.size()) ? &original[i + 2] : nullptr;
+        const DecodedInstr* w = (i + 3 < original.size()) ? &original[i + 3] : nullptr;
+        DecodedInstr fused = x;
+
+        if (x.op == OpCode::ILOAD && y.op == OpCode::ICONST && z && w &&
+            (z->op == OpCode::IADD || (z->op == OpCode::ISUB && y.a != INT_MIN)) &&
+            w->op == OpCode::ISTORE && w->a == x.a) {
+            fused.op = OpCode::IINC;
+            fused.b = (z->op == OpCode::IADD) ? y.a : -y.a;
+        } else if (x.op == OpCode::ILOAD && y.op == OpCode::ILOAD && z && z->op == OpCode::IADD) {
+            fused.op = OpCode::ILOAD2_IADD;
+            fused.b = y.a;
+        } else if (x.op == OpCode::ICONST && y.op == OpCode::IADD) {
+            fused.op = OpCode::IADD_K;
+        } else if (x.op == OpCode::ICONST && y.op == OpCode::ISUB) {
+            fused.op = OpCode::ISUB_K;
+        } else if (fuseCompareBranch(x.op, y.op, fused.op)) {
+            fused.a = y.a; // the branch target
+        } else {
+            continue;
+        }
+        code[i] = fused;
+        ++sites;
+    }
+    return sites;
+}
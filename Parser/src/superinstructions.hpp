@@ -0,0 +1,28 @@
+#ifndef SUPERINSTRUCTIONS_HPP
+#define SUPERINSTRUCTIONS_HPP
+
+#include "vm_opcodes.hpp"
+#include <vector>
+
+// Load-time pass over the simulator's decoded code. Each recognised idiom
+//   ICONST k; IADD                  -> IADD_K k
+//   ICONST k; ISUB                  -> ISUB_K k
+//   ILOAD a; ILOAD b; IADD          -> ILOAD2_IADD a b
+//   ILOAD i; ICONST k; IADD; ISTORE i (or ISUB)  -> IINC i k
+//   icmp_*; jmp_if_false / JNZ      -> icmp_*_jf / icmp_*_jnz
+// has its first instruction replaced by the fused op. The rest of the
+// sequence stays where it was and the fused op jumps past it, so indices do
+// not move and a branch landing inside the sequence still runs the original
+// instructions. Returns the number of sites rewritten.
+size_t fuseSuperinstructions(std::vector<DecodedInstr>& code);
+
+// Number of original instructions a superinstruction stands for; 1 for
+// ordinary opcodes.
+int superinstructionLength(OpCode op);
+
+// Opcode of the first instruction a superinstruction replaced; `op` itself
+// for ordinary opcodes. The fused op's `a` is still right for it, so
+// swapping the opcode back is enough to unfuse one site.
+OpCode unfusedOpcode(OpCode op);
+
+#endif
@@ -0,0 +1,38 @@
+// Offline decoder for the ring-buffer traces written by `--trace=FILE`.
+// Usage: trace_decode <trace file> [last N records]
+#include "vm_trace.hpp"
+#include "vm_opcodes.hpp"
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <trace file> [last N records]" << std::endl;
+        return 1;
+    }
+    try {
+        uint64_t total = 0;
+        std::vector<TraceRecord> records = TraceRing::load(argv[1], total);
+        size_t first = 0;
+        if (argc > 2) {
+            size_t last = std::strtoul(argv[2], nullptr, 10);
+            if (last < records.size()) first = records.size() - last;
+        }
+        std::cout << "# " << total << " instructions recorded, last " << records.size() << " kept" << std::endl;
+        std::cout << "#        seq    pc  opcode                tos  depth" << std::endl;
+        uint64_t seq = total - records.size();
+        for (size_t i = first; i < records.size(); ++i) {
+            const TraceRecord& r = records[i];
+            const char* name = r.opcode < kOpcodeCount
+                ? opcodeName(static_cast<OpCode>(r.opcode)) : "?";
+            std::cout << std::setw(12) << (seq + i) << std::setw(6) << r.pc << "  " << std::left << std::setw(16) << name
+                      << std::right << std::setw(10) << r.tos << std::setw(7) << r.depth << std::endl;
+        }
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
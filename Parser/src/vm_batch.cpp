@@ -0,0 +1,229 @@
+#include "vm_batch.hpp"
+#include "object_file.hpp"
+#include "constant_folding.hpp"
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+void writeEscaped(std::ostream& out, const std::string& text) {
+    for (char c : text) {
+        switch (c) {
+            case '\t': out << "\\t"; break;
+            case '\n': out << "\\n"; break;
+            case '\\': out << "\\\\"; break;
+            default: out << c;
+        }
+    }
+}
+
+} // namespace
+
+// Aligned so that one worker's lock and counters never share a cache line
+// with another's
+struct alignas(64) VMBatch::Worker {
+    std::mutex lock;
+    std::deque<size_t> queue; // indices into `programs`: front for the owner, back for thieves
+    std::unique_ptr<VMSimulator> vm;
+    std::ostringstream output;
+    uint64_t steals = 0;
+};
+
+VMBatch::VMBatch()
+    : threads(0), repeat(1), dispatch_mode(VMSimulator::DispatchMode::Threaded),
+      fuse_superinstructions(true), fold_constants(true), threads_used(0), seconds(0), steals(0) {}
+
+void VMBatch::addInputs(const std::string& path) {
+    std::error_code error;
+    if (fs::is_directory(path, error)) {
+        std::vector<std::string> found;
+        for (const auto& entry : fs::directory_iterator(path)) {
+            if (entry.is_regular_file() && entry.path().extension() == ".o") {
+                found.push_back(entry.path().string());
+            }
+        }
+        std::sort(found.begin(), found.end());
+        for (const auto& program : found) addProgram(program);
+        return;
+    }
+
+    std::ifstream manifest(path);
+    if (!manifest.is_open()) {
+        throw std::runtime_error("Cannot open manifest: " + path);
+    }
+    fs::path base = fs::path(path).parent_path();
+    std::string line;
+    while (std::getline(manifest, line)) {
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') continue;
+        size_t last = line.find_last_not_of(" \t\r");
+        fs::path program = line.substr(first, last - first + 1);
+        addProgram(program.is_absolute() ? program.string() : (base / program).string());
+    }
+}
+
+void VMBatch::addProgram(const std::string& path) {
+    programs.push_back(path);
+}
+
+void VMBatch::setThreads(unsigned count) {
+    threads = count;
+}
+
+void VMBatch::setRepeat(unsigned count) {
+    repeat = count ? count : 1;
+}
+
+void VMBatch::setDispatchMode(VMSimulator::DispatchMode mode) {
+    dispatch_mode = mode;
+}
+
+void VMBatch::setFusion(bool fuse) {
+    fuse_superinstructions = fuse;
+}
+
+void VMBatch::setFolding(bool fold) {
+    fold_constants = fold;
+}
+
+void VMBatch::run() {
+    results.assign(programs.size(), BatchResult{false, 0, 0, "", "not run"});
+    threads_used = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+    if (threads_used > programs.size()) threads_used = static_cast<unsigned>(std::max<size_t>(programs.size(), 1));
+
+    // Contiguous shares keep each worker's programs in input order
+    std::vector<Worker> workers(threads_used);
+    for (unsigned w = 0; w < threads_used; ++w) {
+        size_t begin = programs.size() * w / threads_used;
+        size_t end = programs.size() * (w + 1) / threads_used;
+        for (size_t i = begin; i < end; ++i) workers[w].queue.push_back(i);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> pool;
+    for (unsigned w = 1; w < threads_used; ++w) {
+        pool.emplace_back(&VMBatch::work, this, std::ref(workers[w]), std::ref(workers));
+    }
+    work(workers[0], workers); // the calling thread is worker 0
+    for (auto& thread : pool) thread.join();
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    steals = 0;
+    for (const auto& worker : workers) steals += worker.steals;
+}
+
+void VMBatch::work(Worker& self, std::vector<Worker>& workers) {
+    size_t index;
+    while (take(self, workers, index)) {
+        runProgram(index, self);
+    }
+}
+
+// Programs never create more work, so once every queue has been seen empty
+// there is nothing left to take
+bool VMBatch::take(Worker& self, std::vector<Worker>& workers, size_t& index) {
+    {
+        std::lock_guard<std::mutex> guard(self.lock);
+        if (!self.queue.empty()) {
+            index = self.queue.front();
+            self.queue.pop_front();
+            return true;
+        }
+    }
+    size_t me = &self - workers.data();
+    for (size_t step = 1; step < workers.size(); ++step) {
+        Worker& victim = workers[(me + step) % workers.size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.queue.empty()) {
+            index = victim.queue.back();
+            victim.queue.pop_back();
+            ++self.steals;
+            return true;
+        }
+    }
+    return false;
+}
+
+void VMBatch::runProgram(size_t index, Worker& self) {
+    BatchResult& result = results[index];
+    try {
+        ObjectFile object = parseObjectFile(readHexBytes(programs[index]));
+        Parser parser(object.code);
+        parser.parse();
+        std::vector<Instruction> instructions = insertSymbolLabels(parser.getInstructions(), object.symbols);
+        if (fold_constants) instructions = foldConstants(instructions, object.symbols);
+
+        for (unsigned r = 0; r < repeat; ++r) {
+            if (!self.vm) {
+                self.vm.reset(new VMSimulator(instructions, fuse_superinstructions));
+                self.vm->setTraceMode(VMSimulator::TraceMode::Quiet);
+                self.vm->setOutput(self.output);
+            } else {
+                self.vm->load(instructions, fuse_superinstructions);
+            }
+            self.vm->setDispatchMode(dispatch_mode);
+            self.vm->setSymbols(object.symbols);
+            self.output.str("");
+            self.vm->run();
+        }
+        result = BatchResult{true, self.vm->getExitValue(), self.vm->getInstructionCount(), self.output.str(), ""};
+    } catch (const std::exception& e) {
+        // Anything escaping a worker thread would terminate the batch
+        result = BatchResult{false, 0, 0, self.output.str(), e.what()};
+    }
+}
+
+const std::vector<std::string>& VMBatch::getPrograms() const {
+    return programs;
+}
+
+const std::vector<BatchResult>& VMBatch::getResults() const {
+    return results;
+}
+
+void VMBatch::writeResults(std::ostream& out) const {
+    out << "# program\tstatus\texit\tinstructions\toutput or error\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BatchResult& r = results[i];
+        out << programs[i] << '\t';
+        if (r.ok) {
+            out << "ok\t" << r.exit_value << '\t' << r.instructions << '\t';
+            writeEscaped(out, r.output);
+        } else {
+            out << "error\t-\t-\t";
+            writeEscaped(out, r.error);
+        }
+        out << '\n';
+    }
+}
+
+void VMBatch::writeSummary(std::ostream& out) const {
+    size_t failed = 0;
+    uint64_t executed = 0;
+    for (const auto& r : results) {
+        if (!r.ok) ++failed;
+        executed += r.instructions * repeat;
+    }
+    out << std::fixed << std::setprecision(3);
+    out << "Programs: " << results.size() << " (" << results.size() - failed << " ok, " << failed << " failed)"
+        << ", " << repeat << (repeat == 1 ? " run" : " runs") << " each\n";
+    out << "Workers: " << threads_used << ", " << steals << " programs stolen\n";
+    out << "Wall time: " << seconds << " s, " << executed << " instructions";
+    if (seconds > 0) {
+        out << " (" << std::setprecision(1) << executed / seconds / 1e6 << " M/s)";
+    }
+    out << "\n";
+    out.unsetf(std::ios::floatfield);
+}
@@ -0,0 +1,78 @@
+#ifndef VM_BATCH_HPP
+#define VM_BATCH_HPP
+
+#include "vm_simulator.hpp"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Outcome of one program in a batch
+struct BatchResult {
+    bool ok;
+    int exit_value;
+    uint64_t instructions; // executed by one run
+    std::string output;    // what the program printed
+    std::string error;     // why loading or running failed, when !ok
+};
+
+// Runs many .o programs in one process. Each program is read and parsed
+// once by whichever worker takes it, then run Quiet on that worker's
+// VMSimulator, which is reloaded rather than rebuilt for every program.
+// Workers start with a contiguous share of the programs and steal from the
+// far end of another worker's share when their own runs out. Nothing
+// mutable is shared between VMs: each worker has its own VMSimulator and
+// output buffer, and writes only its programs' slots of the results.
+class VMBatch {
+public:
+    VMBatch();
+
+    // A directory adds its *.o files in name order. Any other file is a
+    // manifest: one program path per line, relative to the manifest's
+    // directory, with blank lines and lines starting with # ignored.
+    void addInputs(const std::string& path);
+    void addProgram(const std::string& path);
+
+    // 0, the default, uses one worker per hardware thread
+    void setThreads(unsigned count);
+    // Runs each program this many times after parsing it once
+    void setRepeat(unsigned count);
+    void setDispatchMode(VMSimulator::DispatchMode mode);
+    void setFusion(bool fuse);
+    // Runs foldConstants on each program first, as main.cpp does
+    void setFolding(bool fold);
+
+    void run();
+
+    // In the order the programs were added
+    const std::vector<std::string>& getPrograms() const;
+    const std::vector<BatchResult>& getResults() const;
+
+    // One tab-separated line per program: path, ok or error, exit value,
+    // instructions, then the output (or the error) with tabs, newlines and
+    // backslashes escaped as in C. Nothing in it depends on the thread count.
+    void writeResults(std::ostream& out) const;
+    // Counts, wall time, throughput and steals
+    void writeSummary(std::ostream& out) const;
+
+private:
+    struct Worker;
+
+    void work(Worker& self, std::vector<Worker>& workers);
+    bool take(Worker& self, std::vector<Worker>& workers, size_t& index);
+    void runProgram(size_t index, Worker& self);
+
+    std::vector<std::string> programs;
+    std::vector<BatchResult> results;
+    unsigned threads;
+    unsigned repeat;
+    VMSimulator::DispatchMode dispatch_mode;
+    bool fuse_superinstructions;
+    bool fold_constants;
+
+    unsigned threads_used;
+    double seconds;
+    uint64_t steals;
+};
+
+#endif
@@ -0,0 +1,551 @@
+#include "vm_jit.hpp"
+#include "superinstructions.hpp"
+#include <cstring>
+
+#if VM_HAS_JIT
+#include <sys/mman.h>
+#include <cstddef>
+
+namespace {
+
+// Register roles in compiled code. All of them are callee-saved in the
+// System V ABI, so they survive calls into `fallback`.
+enum Reg { RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7,
+           R12 = 12, R13 = 13, R14 = 14, R15 = 15 };
+const int SP = RBX;     // operand stack pointer, same meaning as in execute()
+const int COUNT = RBP;  // bytecodes executed
+const int LOCALS = R12; // current frame
+const int TOS = R13;    // top of the operand stack (32-bit)
+const int CTX = R14;    // VMJitContext*
+const int BASE = R15;   // operand stack base, for underflow checks
+
+// Condition codes for jcc/setcc
+enum Cond { CC_B = 0x2, CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5, CC_L = 0xC, CC_GE = 0xD, CC_LE = 0xE, CC_G = 0xF };
+
+// ALU opcode extensions for the 0x81/0x83 immediate group
+enum Alu { ALU_ADD = 0, ALU_AND = 4, ALU_SUB = 5, ALU_CMP = 7 };
+
+// Byte-level x86-64 encoder covering the handful of forms the JIT emits
+class Emitter {
+public:
+    std::vector<uint8_t> bytes;
+
+    size_t size() const { return bytes.size(); }
+    void byte(uint8_t b) { bytes.push_back(b); }
+    void u32(uint32_t v) {
+        for (int i = 0; i < 4; ++i) byte(static_cast<uint8_t>(v >> (8 * i)));
+    }
+    void patch32(size_t at, uint32_t v) {
+        for (int i = 0; i < 4; ++i) bytes[at + i] = static_cast<uint8_t>(v >> (8 * i));
+    }
+
+    void rex(bool wide, int reg, int rm) {
+        uint8_t r = static_cast<uint8_t>(0x40 | (wide ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((rm & 8) ? 1 : 0));
+        if (r != 0x40) byte(r);
+    }
+    // ModRM (and SIB) for [base + disp]
+    void mem(int reg, int base, int32_t disp) {
+        int mod = (disp == 0 && (base & 7) != RBP) ? 0 : (disp >= -128 && disp <= 127 ? 1 : 2);
+        byte(static_cast<uint8_t>((mod << 6) | ((reg & 7) << 3) | (base & 7)));
+        if ((base & 7) == RSP) byte(0x24);
+        if (mod == 1) byte(static_cast<uint8_t>(disp));
+        if (mod == 2) u32(static_cast<uint32_t>(disp));
+    }
+
+    // `op` with a register and a memory operand, e.g. mov r32, [base+disp]
+    void opMem(uint8_t op, bool wide, int reg, int base, int32_t disp) {
+        rex(wide, reg, base);
+        byte(op);
+        mem(reg, base, disp);
+    }
+    // `op` with two registers; `reg` goes in ModRM.reg, `rm` in ModRM.rm
+    void opReg(uint8_t op, bool wide, int reg, int rm) {
+        rex(wide, reg, rm);
+        byte(op);
+        byte(static_cast<uint8_t>(0xC0 | ((reg & 7) << 3) | (rm & 7)));
+    }
+    void aluImm(Alu alu, bool wide, int rm, int32_t imm) {
+        rex(wide, 0, rm);
+        bool small = (imm >= -128 && imm <= 127);
+        byte(small ? 0x83 : 0x81);
+        byte(static_cast<uint8_t>(0xC0 | (alu << 3) | (rm & 7)));
+        if (small) byte(static_cast<uint8_t>(imm)); else u32(static_cast<uint32_t>(imm));
+    }
+    void aluImmMem(Alu alu, int base, int32_t disp, int32_t imm) {
+        rex(false, 0, base);
+        bool small = (imm >= -128 && imm <= 127);
+        byte(small ? 0x83 : 0x81);
+        mem(alu, base, disp);
+        if (small) byte(static_cast<uint8_t>(imm)); else u32(static_cast<uint32_t>(imm));
+    }
+
+    void load32(int reg, int base, int32_t disp) { opMem(0x8B, false, reg, base, disp); }
+    void store32(int base, int32_t disp, int reg) { opMem(0x89, false, reg, base, disp); }
+    void load64(int reg, int base, int32_t disp) { opMem(0x8B, true, reg, base, disp); }
+    void store64(int base, int32_t disp, int reg) { opMem(0x89, true, reg, base, disp); }
+    void movImm32(int reg, int32_t imm) {
+        rex(false, 0, reg);
+        byte(static_cast<uint8_t>(0xB8 + (reg & 7)));
+        u32(static_cast<uint32_t>(imm));
+    }
+    void push(int reg) { rex(false, 0, reg); byte(static_cast<uint8_t>(0x50 + (reg & 7))); }
+    void pop(int reg) { rex(false, 0, reg); byte(static_cast<uint8_t>(0x58 + (reg & 7))); }
+    void ret() { byte(0xC3); }
+
+    // Branches return the offset of their rel32 field for later patching
+    size_t jmp() { byte(0xE9); u32(0); return size() - 4; }
+    size_t call() { byte(0xE8); u32(0); return size() - 4; }
+    size_t jcc(Cond cc) { byte(0x0F); byte(static_cast<uint8_t>(0x80 | cc)); u32(0); return size() - 4; }
+    void bind(size_t rel32_at, size_t target) {
+        patch32(rel32_at, static_cast<uint32_t>(static_cast<int64_t>(target) - static_cast<int64_t>(rel32_at + 4)));
+    }
+};
+
+// Instruction after `d` when it does not jump; 0 when it never falls through
+size_t fallthrough(const DecodedInstr& d, size_t index) {
+    switch (d.op) {
+        case OpCode::JMP: case OpCode::RET: case OpCode::HALT:
+            return 0;
+        default:
+            return index + superinstructionLength(d.op);
+    }
+}
+
+bool hasTarget(OpCode op) {
+    switch (op) {
+        case OpCode::JMP: case OpCode::JMP_IF_FALSE: case OpCode::JNZ: case OpCode::INVOKE:
+        case OpCode::ICMP_EQ_JF: case OpCode::ICMP_LT_JF: case OpCode::ICMP_GT_JF:
+        case OpCode::ICMP_EQ_JT: case OpCode::ICMP_LT_JT: case OpCode::ICMP_GT_JT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Control may leave between this instruction and the next one it falls
+// through to, so the bytecode count for what follows is added separately
+bool endsBlock(OpCode op) {
+    return hasTarget(op) || op == OpCode::RET || op == OpCode::HALT;
+}
+
+class Compiler {
+public:
+    Compiler(const std::vector<DecodedInstr>& code, const std::vector<bool>& function_starts, size_t frame_slots)
+        : code(code), function_starts(function_starts), frame_bytes(static_cast<int32_t>(frame_slots * 4)) {}
+
+    // Returns the native offset of every instruction, -1 where none was emitted
+    std::vector<int64_t> compile(std::vector<uint8_t>& out, size_t& functions);
+
+private:
+    struct Stub {
+        size_t rel32_at;
+        uint32_t index;
+        VMJit::Status status;
+    };
+
+    void markLive();
+    void emitPrologue();
+    void emitEpilogue();
+    void emitInstruction(size_t i);
+    void emitStubs();
+
+    void toStub(size_t rel32_at, size_t i, VMJit::Status status) {
+        stubs.push_back(Stub{rel32_at, static_cast<uint32_t>(i), status});
+    }
+    void toInstr(size_t rel32_at, size_t target) { branches.push_back(std::make_pair(rel32_at, target)); }
+
+    void callHost(int32_t fn, int32_t index);
+    void need(int n, size_t i);
+    void push(size_t i);
+    void drop();
+
+    const std::vector<DecodedInstr>& code;
+    const std::vector<bool>& function_starts;
+    int32_t frame_bytes;
+    Emitter e;
+    std::vector<bool> live;  // reachable by falling through or by a jump
+    std::vector<bool> label; // entered other than by falling through from the previous emitted instruction
+    std::vector<int64_t> offset;
+    std::vector<std::pair<size_t, size_t> > branches; // rel32 position, instruction index
+    std::vector<Stub> stubs;
+    size_t exit_at;
+};
+
+void Compiler::markLive() {
+    live.assign(code.size(), false);
+    label.assign(code.size(), false);
+    for (size_t i = 0; i < code.size(); ++i) {
+        if (function_starts[i]) live[i] = label[i] = true;
+        if (hasTarget(code[i].op)) {
+            live[code[i].a] = label[code[i].a] = true;
+        }
+    }
+    // Successors always have higher indices, so one forward pass settles
+    // which fused tails are only reachable by jumping into them
+    for (size_t i = 0; i < code.size(); ++i) {
+        if (!live[i]) continue;
+        size_t next = fallthrough(code[i], i);
+        if (next != 0 && next < code.size()) live[next] = true;
+    }
+    for (size_t i = 0; i < code.size(); ++i) {
+        if (!live[i]) continue;
+        size_t next = fallthrough(code[i], i);
+        if (next == 0 || next >= code.size()) continue;
+        size_t emitted_next = i + 1;
+        while (emitted_next < code.size() && !live[emitted_next]) ++emitted_next;
+        if (emitted_next != next || endsBlock(code[i].op)) label[next] = true;
+    }
+}
+
+// int entry(VMJitContext* ctx, int* locals, const void* start, void* stack_top)
+void Compiler::emitPrologue() {
+    e.push(RBX); e.push(RBP); e.push(R12); e.push(R13); e.push(R14); e.push(R15);
+    e.aluImm(ALU_SUB, true, RSP, 8);
+    e.opReg(0x89, true, RDI, CTX);
+    e.store64(CTX, offsetof(VMJitContext, saved_rsp), RSP);
+    e.opReg(0x89, true, RCX, RSP); // switch to the call stack from reserveCalls()
+    e.opReg(0x89, true, RSI, LOCALS);
+    e.load64(SP, CTX, offsetof(VMJitContext, sp));
+    e.load32(TOS, SP, 0);
+    e.load64(BASE, CTX, offsetof(VMJitContext, stack_base));
+    e.load64(COUNT, CTX, offsetof(VMJitContext, executed));
+    e.byte(0xFF); e.byte(0xE2); // jmp rdx
+}
+
+// Shared exit with the status in eax; unwinds however deep the native
+// call chain is
+void Compiler::emitEpilogue() {
+    exit_at = e.size();
+    e.store32(SP, 0, TOS);
+    e.store64(CTX, offsetof(VMJitContext, sp), SP);
+    e.store64(CTX, offsetof(VMJitContext, executed), COUNT);
+    e.load64(RSP, CTX, offsetof(VMJitContext, saved_rsp));
+    e.aluImm(ALU_ADD, true, RSP, 8);
+    e.pop(R15); e.pop(R14); e.pop(R13); e.pop(R12); e.pop(RBP); e.pop(RBX);
+    e.ret();
+}
+
+// Calls the host function at `fn` in the context with (ctx, index), or
+// (ctx) when `index` is negative, with the stack stored before and
+// reloaded after. Leaves flags set from the result: NE for failure.
+void Compiler::callHost(int32_t fn, int32_t index) {
+    e.store32(SP, 0, TOS);
+    e.store64(CTX, offsetof(VMJitContext, sp), SP);
+    e.opReg(0x89, true, CTX, RDI);
+    if (index >= 0) e.movImm32(RSI, index);
+    e.opReg(0x89, true, RSP, RAX);  // align the native stack for the call
+    e.aluImm(ALU_AND, true, RSP, -16);
+    e.push(RAX); e.push(RAX);
+    e.rex(false, 0, CTX); e.byte(0xFF); e.mem(2, CTX, fn); // call [ctx + fn]
+    e.pop(RSP);
+    e.load64(SP, CTX, offsetof(VMJitContext, sp));
+    e.load32(TOS, SP, 0);
+    e.opReg(0x85, false, RAX, RAX);
+}
+
+void Compiler::need(int n, size_t i) {
+    if (n <= 0) return;
+    e.opMem(0x8D, true, RAX, BASE, 4 * n); // lea rax, [base + 4n]
+    e.opReg(0x39, true, RAX, SP);          // cmp sp, rax
+    toStub(e.jcc(CC_B), i, VMJit::kStackUnderflow);
+}
+
+// Makes room for a new top; the caller then loads it into TOS
+void Compiler::push(size_t i) {
+    e.opMem(0x3B, true, SP, CTX, offsetof(VMJitContext, stack_limit)); // cmp sp, [limit]
+    toStub(e.jcc(CC_AE), i, VMJit::kStackOverflow);
+    e.store32(SP, 0, TOS);
+    e.aluImm(ALU_ADD, true, SP, 4);
+}
+
+void Compiler::drop() {
+    e.aluImm(ALU_SUB, true, SP, 4);
+    e.load32(TOS, SP, 0);
+}
+
+void Compiler::emitInstruction(size_t i) {
+    const DecodedInstr& d = code[i];
+    switch (d.op) {
+        case OpCode::ICONST:
+            push(i);
+            e.movImm32(TOS, d.a);
+            break;
+        case OpCode::ILOAD:
+            push(i);
+            e.load32(TOS, LOCALS, 4 * d.a);
+            break;
+        case OpCode::ISTORE:
+            need(1, i);
+            e.store32(LOCALS, 4 * d.a, TOS);
+            drop();
+            break;
+        case OpCode::IADD:
+            need(2, i);
+            e.aluImm(ALU_SUB, true, SP, 4);
+            e.opMem(0x03, false, TOS, SP, 0); // add tos, [sp]
+            break;
+        case OpCode::ISUB:
+            need(2, i);
+            e.aluImm(ALU_SUB, true, SP, 4);
+            e.load32(RAX, SP, 0);
+            e.opReg(0x29, false, TOS, RAX); // sub eax, tos
+            e.opReg(0x89, false, RAX, TOS);
+            break;
+        case OpCode::IMUL:
+            need(2, i);
+            e.aluImm(ALU_SUB, true, SP, 4);
+            e.rex(false, TOS, SP); e.byte(0x0F); e.byte(0xAF); e.mem(TOS, SP, 0); // imul tos, [sp]
+            break;
+        case OpCode::IDIV:
+            need(2, i);
+            e.opReg(0x85, false, TOS, TOS);
+            toStub(e.jcc(CC_E), i, VMJit::kDivisionByZero);
+            e.aluImm(ALU_SUB, true, SP, 4);
+            e.load32(RAX, SP, 0);
+            e.byte(0x99);                                       // cdq
+            e.rex(false, 0, TOS); e.byte(0xF7); e.byte(0xF8 | (TOS & 7)); // idiv tos
+            e.opReg(0x89, false, RAX, TOS);
+            break;
+        case OpCode::POP:
+            need(1, i);
+            drop();
+            break;
+        case OpCode::DUP:
+            need(1, i);
+            push(i);
+            break;
+        case OpCode::ICMP_EQ: case OpCode::ICMP_LT: case OpCode::ICMP_GT: {
+            Cond cc = d.op == OpCode::ICMP_EQ ? CC_E : (d.op == OpCode::ICMP_LT ? CC_L : CC_G);
+            need(2, i);
+            e.aluImm(ALU_SUB, true, SP, 4);
+            e.opMem(0x39, false, TOS, SP, 0);                  // cmp [sp], tos
+            e.byte(0x0F); e.byte(static_cast<uint8_t>(0x90 | cc)); e.byte(0xC0); // setcc al
+            e.rex(false, TOS, RAX); e.byte(0x0F); e.byte(0xB6); e.byte(0xC0 | ((TOS & 7) << 3)); // movzx tos, al
+            break;
+        }
+        case OpCode::JMP:
+            toInstr(e.jmp(), d.a);
+            break;
+        case OpCode::JMP_IF_FALSE: case OpCode::JNZ:
+            need(1, i);
+            e.opReg(0x85, false, TOS, TOS);
+            e.load32(TOS, SP, -4);           // drop without touching flags
+            e.opMem(0x8D, true, SP, SP, -4);
+            toInstr(e.jcc(d.op == OpCode::JNZ ? CC_NE : CC_E), d.a);
+            break;
+        case OpCode::INVOKE: {
+            need(d.b, i);
+            e.load32(RAX, CTX, offsetof(VMJitContext, call_depth));
+            e.opMem(0x3B, false, RAX, CTX, offsetof(VMJitContext, call_limit));
+            size_t room = e.jcc(CC_B);
+            // Out of frames: let the host grow the stacks, then pick up
+            // wherever they moved to
+            e.store64(CTX, offsetof(VMJitContext, locals), LOCALS);
+            callHost(offsetof(VMJitContext, grow), -1);
+            toStub(e.jcc(CC_NE), i, VMJit::kCallOverflow);
+            e.load64(BASE, CTX, offsetof(VMJitContext, stack_base));
+            e.load64(LOCALS, CTX, offsetof(VMJitContext, locals));
+            e.load32(RAX, CTX, offsetof(VMJitContext, call_depth));
+            e.bind(room, e.size());
+            e.aluImm(ALU_ADD, false, RAX, 1);
+            e.store32(CTX, offsetof(VMJitContext, call_depth), RAX);
+            e.aluImm(ALU_ADD, true, LOCALS, frame_bytes);
+            // Arguments become the callee's first locals, the last pushed in the highest slot
+            for (int k = d.b - 1; k >= 0; --k) {
+                e.store32(LOCALS, 4 * k, TOS);
+                drop();
+            }
+            toInstr(e.call(), d.a);
+            break;
+        }
+        case OpCode::RET:
+            e.aluImmMem(ALU_CMP, CTX, offsetof(VMJitContext, call_depth), 0);
+            toStub(e.jcc(CC_E), i, VMJit::kExited);
+            e.aluImmMem(ALU_SUB, CTX, offsetof(VMJitContext, call_depth), 1);
+            e.aluImm(ALU_SUB, true, LOCALS, frame_bytes);
+            e.ret();
+            break;
+        case OpCode::HALT:
+            toStub(e.jmp(), i, VMJit::kExited);
+            break;
+        case OpCode::IADD_K: case OpCode::ISUB_K:
+            need(1, i);
+            e.aluImm(d.op == OpCode::IADD_K ? ALU_ADD : ALU_SUB, false, TOS, d.a);
+            break;
+        case OpCode::ILOAD2_IADD:
+            push(i);
+            e.load32(TOS, LOCALS, 4 * d.a);
+            e.opMem(0x03, false, TOS, LOCALS, 4 * d.b);
+            break;
+        case OpCode::IINC:
+            e.aluImmMem(ALU_ADD, LOCALS, 4 * d.a, d.b);
+            break;
+        case OpCode::ICMP_EQ_JF: case OpCode::ICMP_LT_JF: case OpCode::ICMP_GT_JF:
+        case OpCode::ICMP_EQ_JT: case OpCode::ICMP_LT_JT: case OpCode::ICMP_GT_JT: {
+            Cond cc;
+            switch (d.op) {
+                case OpCode::ICMP_EQ_JF: cc = CC_NE; break;
+                case OpCode::ICMP_LT_JF: cc = CC_GE; break;
+                case OpCode::ICMP_GT_JF: cc = CC_LE; break;
+                case OpCode::ICMP_EQ_JT: cc = CC_E; break;
+                case OpCode::ICMP_LT_JT: cc = CC_L; break;
+                default: cc = CC_G; break;
+            }
+            need(2, i);
+            e.load32(RAX, SP, -4);
+            e.opReg(0x39, false, TOS, RAX);  // cmp eax, tos
+            e.load32(TOS, SP, -8);
+            e.opMem(0x8D, true, SP, SP, -8);
+            toInstr(e.jcc(cc), d.a);
+            break;
+        }
+        default:
+            // Heap and print instructions: let the interpreter's handler
+            // run them
+            callHost(offsetof(VMJitContext, fallback), static_cast<int32_t>(i));
+            toStub(e.jcc(CC_NE), i, VMJit::kFallbackFailed);
+            break;
+    }
+}
+
+void Compiler::emitStubs() {
+    for (const Stub& s : stubs) {
+        e.bind(s.rel32_at, e.size());
+        e.rex(false, 0, CTX); e.byte(0xC7); e.mem(0, CTX, offsetof(VMJitContext, stop_index)); e.u32(s.index);
+        e.movImm32(RAX, s.status);
+        e.bind(e.jmp(), exit_at);
+    }
+}
+
+std::vector<int64_t> Compiler::compile(std::vector<uint8_t>& out, size_t& functions) {
+    markLive();
+    offset.assign(code.size(), -1);
+    emitPrologue();
+    emitEpilogue();
+
+    functions = 0;
+    for (size_t i = 0; i < code.size(); ++i) {
+        if (function_starts[i]) ++functions;
+        if (!live[i]) continue;
+        offset[i] = static_cast<int64_t>(e.size());
+        if (label[i]) {
+            // Count the whole run of instructions that cannot be left early
+            int64_t block = 0;
+            for (size_t j = i; j < code.size();) {
+                if (code[j].op != OpCode::HALT) block += superinstructionLength(code[j].op);
+                size_t next = fallthrough(code[j], j);
+                if (next == 0 || next >= code.size() || endsBlock(code[j].op) || label[next]) break;
+                j = next;
+            }
+            if (block > 0) e.aluImm(ALU_ADD, true, COUNT, static_cast<int32_t>(block));
+        }
+        emitInstruction(i);
+        size_t next = fallthrough(code[i], i);
+        if (next == 0) continue;
+        size_t emitted_next = i + 1;
+        while (emitted_next < code.size() && !live[emitted_next]) ++emitted_next;
+        if (next != emitted_next) toInstr(e.jmp(), next);
+    }
+    emitStubs();
+
+    for (const auto& b : branches) {
+        e.bind(b.first, static_cast<size_t>(offset[b.second]));
+    }
+    out.swap(e.bytes);
+    return offset;
+}
+
+} // namespace
+
+VMJit::VMJit() : buffer(nullptr), buffer_size(0), code_bytes(0), functions(0), stack(nullptr), stack_size(0) {}
+
+VMJit::~VMJit() {
+    if (buffer) munmap(buffer, buffer_size);
+    if (stack) munmap(stack, stack_size);
+}
+
+bool VMJit::compile(const std::vector<DecodedInstr>& code, const std::vector<bool>& function_starts,
+                    size_t frame_slots) {
+    if (buffer) return true;
+    std::vector<uint8_t> bytes;
+    Compiler compiler(code, function_starts, frame_slots);
+    std::vector<int64_t> offsets = compiler.compile(bytes, functions);
+
+    // Written while writable, then flipped to read+execute; never both
+    void* mapped = mmap(nullptr, bytes.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapped == MAP_FAILED) return false;
+    std::memcpy(mapped, bytes.data(), bytes.size());
+    if (mprotect(mapped, bytes.size(), PROT_READ | PROT_EXEC) != 0) {
+        munmap(mapped, bytes.size());
+        return false;
+    }
+    buffer = static_cast<uint8_t*>(mapped);
+    buffer_size = bytes.size();
+    code_bytes = bytes.size();
+    native_offset.swap(offsets);
+    return true;
+}
+
+bool VMJit::reserveCalls(size_t calls) {
+    // Return addresses, plus room for the host functions native code calls
+    // and a guard page at the bottom. Pages are only touched as the calls
+    // nest, so a large reservation costs address space, not memory.
+    const size_t page = 4096;
+    size_t bytes = ((calls * 8 + (1 << 20)) / page + 2) * page;
+    if (stack && stack_size >= bytes) return true;
+    void* mapped = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mapped == MAP_FAILED) return false;
+    mprotect(mapped, page, PROT_NONE);
+    if (stack) munmap(stack, stack_size);
+    stack = static_cast<uint8_t*>(mapped);
+    stack_size = bytes;
+    return true;
+}
+
+int VMJit::run(VMJitContext& ctx, int* locals, size_t start) const {
+    typedef int (*Entry)(VMJitContext*, int*, const void*, void*);
+    Entry entry = reinterpret_cast<Entry>(buffer); // the prologue is first
+    return entry(&ctx, locals, buffer + native_offset[start], stack + stack_size);
+}
+
+#else
+
+VMJit::VMJit() : buffer(nullptr), buffer_size(0), code_bytes(0), functions(0), stack(nullptr), stack_size(0) {}
+VMJit::~VMJit() {}
+
+bool VMJit::compile(const std::vector<DecodedInstr>&, const std::vector<bool>&, size_t) {
+    return false;
+}
+
+bool VMJit::reserveCalls(size_t) {
+    return false;
+}
+
+int VMJit::run(VMJitContext&, int*, size_t) const {
+    return kExited;
+}
+
+#endif
+
+bool VMJit::isCompiled() const {
+    return buffer != nullptr;
+}
+
+void VMJit::clear() {
+#if VM_HAS_JIT
+    if (buffer) munmap(buffer, buffer_size);
+#endif
+    buffer = nullptr;
+    buffer_size = 0;
+    code_bytes = 0;
+    native_offset.clear();
+    functions = 0;
+}
+
+size_t VMJit::functionCount() const {
+    return functions;
+}
+
+size_t VMJit::codeBytes() const {
+    return code_bytes;
+}
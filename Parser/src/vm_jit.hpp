@@ -0,0 +1,94 @@
+#ifndef VM_JIT_HPP
+#define VM_JIT_HPP
+
+#include "vm_opcodes.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// The JIT emits raw x86-64 and maps it with mmap, so it is only built for
+// x86-64 Linux hosts. Build with -DVM_NO_JIT to leave it out anywhere.
+#if defined(__x86_64__) && defined(__linux__) && !defined(VM_NO_JIT)
+#define VM_HAS_JIT 1
+#else
+#define VM_HAS_JIT 0
+#endif
+
+// State shared between VMSimulator and JIT-compiled code. Native code reads
+// and writes these fields by offset, so the struct must stay standard
+// layout. The operand stack is in memory form on entry and exit: the top
+// value sits at *sp.
+struct VMJitContext {
+    int* sp;
+    int* stack_base;
+    int* stack_limit;         // pushing at or past this overflows
+    uint32_t call_depth;
+    uint32_t call_limit;
+    uint64_t executed;        // bytecodes run by native code, as the interpreter counts them
+    uint32_t stop_index;      // instruction that ended the run
+    void* saved_rsp;          // native stack pointer at entry, for exits from any depth
+    // Runs code[index] for native code, which stores sp first and reloads it
+    // after. Non-zero means the instruction failed.
+    int (*fallback)(VMJitContext* ctx, uint32_t index);
+    // Called by INVOKE when call_depth reaches call_limit, with sp and
+    // locals stored. It may move the stacks and frames; native code reloads
+    // sp, stack_base and locals after it. Non-zero means no room was made.
+    int (*grow)(VMJitContext* ctx);
+    int* locals;              // current frame, for `grow`
+    void* host;               // for `fallback` and `grow`
+};
+
+// Baseline JIT: compiles the decoded (and possibly fused) instruction stream
+// into x86-64, one function after another, in a single executable buffer.
+// Every instruction becomes a fixed native sequence with the top of the
+// operand stack in a register; INVOKE and RET become native call and ret.
+// Heap and print instructions call `fallback` to run the interpreter's
+// handler instead of being compiled.
+class VMJit {
+public:
+    enum Status {
+        kExited = 0,     // RET from the entry frame or HALT
+        kStackUnderflow,
+        kStackOverflow,
+        kCallOverflow,
+        kDivisionByZero,
+        kFallbackFailed, // `fallback` returned non-zero
+    };
+
+    VMJit();
+    ~VMJit();
+    VMJit(const VMJit&) = delete;
+    VMJit& operator=(const VMJit&) = delete;
+
+    // `function_starts` marks the first instruction of every function.
+    // Returns false, leaving nothing compiled, when the JIT is not built in
+    // or executable memory is unavailable.
+    bool compile(const std::vector<DecodedInstr>& code, const std::vector<bool>& function_starts,
+                 size_t frame_slots);
+    bool isCompiled() const;
+    // Releases the compiled code so another program can be compiled
+    void clear();
+
+    // Native code runs on its own stack, where each nested INVOKE takes one
+    // return address. Maps one with room for `calls` nested calls unless
+    // the current one is large enough; false when that fails.
+    bool reserveCalls(size_t calls);
+
+    // Runs from instruction `start` with `locals` as the current frame until
+    // the program exits or fails; returns a Status.
+    int run(VMJitContext& ctx, int* locals, size_t start) const;
+
+    size_t functionCount() const;
+    size_t codeBytes() const;
+
+private:
+    uint8_t* buffer; // mmap'd, read+execute once compiled
+    size_t buffer_size;
+    size_t code_bytes;
+    std::vector<int64_t> native_offset; // per instruction index, -1 if not emitted
+    size_t functions;
+    uint8_t* stack; // mmap'd, for reserveCalls()
+    size_t stack_size;
+};
+
+#endif
@@ -0,0 +1,15 @@
+#include "vm_opcodes.hpp"
+
+namespace {
+
+const char* const kOpcodeNames[] = {
+#define VM_OPCODE_NAME(op, name) name,
+    VM_OPCODES(VM_OPCODE_NAME)
+#undef VM_OPCODE_NAME
+};
+
+} // namespace
+
+const char* opcodeName(OpCode op) {
+    return kOpcodeNames[static_cast<size_t>(op)];
+}
@@ -0,0 +1,72 @@
+#ifndef VM_OPCODES_HPP
+#define VM_OPCODES_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Every opcode the simulator can execute, with the name the parser gives it.
+// LOAD/STORE/JMP_IF_ZERO/ICMP are older spellings and decode to the same ops.
+#define VM_OPCODES(X)                 \
+    X(ICONST,       "ICONST")         \
+    X(IADD,         "IADD")           \
+    X(ISUB,         "ISUB")           \
+    X(IMUL,         "IMUL")           \
+    X(IDIV,         "IDIV")           \
+    X(POP,          "POP")            \
+    X(DUP,          "DUP")            \
+    X(ICMP_EQ,      "icmp_eq")        \
+    X(ICMP_LT,      "icmp_lt")        \
+    X(ICMP_GT,      "icmp_gt")        \
+    X(ILOAD,        "ILOAD")          \
+    X(ISTORE,       "ISTORE")         \
+    X(JMP,          "JMP")            \
+    X(JMP_IF_FALSE, "jmp_if_false")   \
+    X(JNZ,          "JNZ")            \
+    X(INVOKE,       "INVOKE")         \
+    X(RET,          "RET")            \
+    X(NEW_ARRAY,    "NEW_ARRAY")      \
+    X(SET_ELEM,     "SET_ELEM")       \
+    X(GET_ELEM,     "GET_ELEM")       \
+    X(NEW_STRING,   "NEW_STRING")     \
+    X(SET_CHAR,     "SET_CHAR")       \
+    X(GET_CHAR,     "GET_CHAR")       \
+    X(PRINT_I,      "PRINT_I")        \
+    X(PRINT_S,      "PRINT_S")        \
+    X(HALT,         "HALT")           \
+    /* placed over an instruction by VMSimulator::setCheckpoint() */ \
+    X(CHECKPOINT,   "CHECKPOINT")     \
+    /* superinstructions, only produced by fuseSuperinstructions() */ \
+    X(IADD_K,       "IADD_K")         \
+    X(ISUB_K,       "ISUB_K")         \
+    X(ILOAD2_IADD,  "ILOAD2_IADD")    \
+    X(IINC,         "IINC")           \
+    X(ICMP_EQ_JF,   "icmp_eq_jf")     \
+    X(ICMP_LT_JF,   "icmp_lt_jf")     \
+    X(ICMP_GT_JF,   "icmp_gt_jf")     \
+    X(ICMP_EQ_JT,   "icmp_eq_jnz")    \
+    X(ICMP_LT_JT,   "icmp_lt_jnz")    \
+    X(ICMP_GT_JT,   "icmp_gt_jnz")
+
+enum class OpCode : uint8_t {
+#define VM_OPCODE_ENUM(op, name) op,
+    VM_OPCODES(VM_OPCODE_ENUM)
+#undef VM_OPCODE_ENUM
+};
+
+#define VM_OPCODE_COUNT(op, name) +1
+const size_t kOpcodeCount = 0 VM_OPCODES(VM_OPCODE_COUNT);
+#undef VM_OPCODE_COUNT
+
+const char* opcodeName(OpCode op);
+
+// One instruction in the simulator's execution form. Jump and INVOKE
+// targets are already resolved from byte offsets to indices into the
+// decoded vector, so the dispatch loop never looks at a string.
+struct DecodedInstr {
+    OpCode op;
+    int a; // ICONST value, local index, or jump/call target
+    int b; // INVOKE argument count, second local or increment of a superinstruction
+    const void* handler; // handler label, bound on the first threaded run
+};
+
+#endif
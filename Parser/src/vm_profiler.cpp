@@ -0,0 +1,134 @@
+#include "vm_profiler.hpp"
+#include <algorithm>
+#include <string>
+#include <iomanip>
+
+namespace {
+
+// Name of the function a decoded index belongs to: the nearest named start
+// at or before it
+const std::string& functionAt(const std::vector<std::string>& function_names, size_t index) {
+    static const std::string unknown = "?";
+    for (size_t i = index + 1; i-- > 0;) {
+        if (i < function_names.size() && !function_names[i].empty()) return function_names[i];
+    }
+    return unknown;
+}
+
+double percent(uint64_t part, uint64_t whole) {
+    return whole ? 100.0 * static_cast<double>(part) / static_cast<double>(whole) : 0.0;
+}
+
+} // namespace
+
+VMProfile::VMProfile() : max_stack_depth(0), max_call_depth(0), current(0), call_depth(0), mark(0) {}
+
+void VMProfile::reset(size_t code_size) {
+    pc_counts.assign(code_size, 0);
+    max_stack_depth = 0;
+    max_call_depth = 0;
+    nodes.assign(1, CallNode{-1, 0, 0, {}});
+    current = 0;
+    call_depth = 0;
+    mark = 0;
+}
+
+void VMProfile::account(uint64_t now) {
+    nodes[current].self += now - mark;
+    mark = now;
+}
+
+void VMProfile::enter(uint32_t target, uint64_t now) {
+    account(now);
+    int child = -1;
+    for (int c : nodes[current].children) {
+        if (nodes[c].function == target) { child = c; break; }
+    }
+    if (child < 0) {
+        child = static_cast<int>(nodes.size());
+        nodes.push_back(CallNode{current, target, 0, {}});
+        nodes[current].children.push_back(child);
+    }
+    current = child;
+    if (++call_depth > max_call_depth) max_call_depth = call_depth;
+}
+
+void VMProfile::leave(uint64_t now) {
+    account(now);
+    if (nodes[current].parent >= 0) current = nodes[current].parent;
+    if (call_depth > 0) --call_depth;
+}
+
+void VMProfile::finish(uint64_t now) {
+    account(now);
+}
+
+void VMProfile::writeReport(std::ostream& out, const std::vector<DecodedInstr>& code, size_t entry,
+                            const std::vector<std::string>& function_names) const {
+    uint64_t dispatches = 0;
+    std::vector<uint64_t> by_opcode(kOpcodeCount, 0);
+    std::vector<std::pair<uint64_t, size_t>> hot_pcs;
+    std::vector<std::pair<uint64_t, uint32_t>> calls; // (count, target)
+    for (size_t pc = 0; pc < pc_counts.size(); ++pc) {
+        uint64_t n = pc_counts[pc];
+        if (n == 0 || code[pc].op == OpCode::HALT) continue;
+        dispatches += n;
+        by_opcode[static_cast<size_t>(code[pc].op)] += n;
+        hot_pcs.push_back({n, pc});
+        if (code[pc].op == OpCode::INVOKE) {
+            uint32_t target = static_cast<uint32_t>(code[pc].a);
+            auto it = std::find_if(calls.begin(), calls.end(), [&](const std::pair<uint64_t, uint32_t>& c) { return c.second == target; });
+            if (it == calls.end()) calls.push_back({n, target}); else it->first += n;
+        }
+    }
+    auto by_count = [](const auto& x, const auto& y) { return x.first > y.first || (x.first == y.first && x.second < y.second); };
+
+    out << "--- VM Profile ---\n";
+    out << "Dispatches: " << dispatches << "\n";
+    out << "Max operand stack depth: " << max_stack_depth << "\n";
+    out << "Max call depth: " << max_call_depth << "\n";
+    out << "Entry: " << functionAt(function_names, entry) << "\n";
+
+    std::vector<std::pair<uint64_t, size_t>> ops;
+    for (size_t op = 0; op < by_opcode.size(); ++op) {
+        if (by_opcode[op]) ops.push_back({by_opcode[op], op});
+    }
+    std::sort(ops.begin(), ops.end(), by_count);
+    out << "\nOpcodes by dispatch count:\n";
+    out << std::right << std::setw(14) << "count" << std::setw(8) << "%" << "  opcode\n";
+    for (const auto& o : ops) {
+        out << std::setw(14) << o.first << std::setw(7) << std::fixed << std::setprecision(2)
+            << percent(o.first, dispatches) << "%  " << opcodeName(static_cast<OpCode>(o.second)) << "\n";
+    }
+
+    std::sort(hot_pcs.begin(), hot_pcs.end(), by_count);
+    if (hot_pcs.size() > 20) hot_pcs.resize(20);
+    out << "\nHottest instructions:\n";
+    out << std::setw(14) << "count" << std::setw(8) << "%" << std::setw(7) << "pc" << "  function / instruction\n";
+    for (const auto& h : hot_pcs) {
+        const DecodedInstr& d = code[h.second];
+        out << std::setw(14) << h.first << std::setw(7) << percent(h.first, dispatches) << "%" << std::setw(7) << h.second
+            << "  " << functionAt(function_names, h.second) << ": " << opcodeName(d.op) << "\n";
+    }
+
+    std::sort(calls.begin(), calls.end(), by_count);
+    out << "\nINVOKE targets:\n";
+    out << std::setw(14) << "calls" << "  function\n";
+    for (const auto& c : calls) {
+        out << std::setw(14) << c.first << "  " << functionAt(function_names, c.second) << "\n";
+    }
+    out.unsetf(std::ios::floatfield);
+}
+
+void VMProfile::writeCollapsed(std::ostream& out, size_t entry, const std::vector<std::string>& function_names) const {
+    for (size_t n = 0; n < nodes.size(); ++n) {
+        if (nodes[n].self == 0) continue;
+        std::vector<std::string> path;
+        for (int i = static_cast<int>(n); i > 0; i = nodes[i].parent) {
+            path.push_back(functionAt(function_names, nodes[i].function));
+        }
+        out << functionAt(function_names, entry);
+        for (size_t i = path.size(); i-- > 0;) out << ";" << path[i];
+        out << " " << nodes[n].self << "\n";
+    }
+}
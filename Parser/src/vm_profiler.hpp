@@ -0,0 +1,53 @@
+#ifndef VM_PROFILER_HPP
+#define VM_PROFILER_HPP
+
+#include "vm_opcodes.hpp"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Counters gathered by VMSimulator in TraceMode::Profile. The run loop only
+// bumps a per-PC counter and the deepest stack pointer; per-opcode and
+// per-INVOKE-target figures are derived from the PC counts when a report
+// is written. Calls and returns move a cursor through a tree of call paths
+// so the collapsed-stack output costs nothing between calls.
+class VMProfile {
+public:
+    VMProfile();
+
+    void reset(size_t code_size);
+
+    // `now` is the number of bytecodes executed so far
+    void enter(uint32_t target, uint64_t now);
+    void leave(uint64_t now);
+    void finish(uint64_t now);
+
+    std::vector<uint64_t> pc_counts; // dispatches per decoded instruction
+    size_t max_stack_depth;
+    size_t max_call_depth;
+
+    // Sorted text report: opcodes, hottest PCs and INVOKE targets, with
+    // function names taken from the .o symbol table
+    void writeReport(std::ostream& out, const std::vector<DecodedInstr>& code, size_t entry,
+                     const std::vector<std::string>& function_names) const;
+    // One "main;f;g count" line per call path, as flamegraph.pl expects
+    void writeCollapsed(std::ostream& out, size_t entry, const std::vector<std::string>& function_names) const;
+
+private:
+    struct CallNode {
+        int parent;
+        uint32_t function; // decoded index of the callee's first instruction
+        uint64_t self;     // bytecodes executed with this path on top
+        std::vector<int> children;
+    };
+
+    void account(uint64_t now);
+
+    std::vector<CallNode> nodes; // nodes[0] is the entry function
+    int current;
+    size_t call_depth;
+    uint64_t mark;
+};
+
+#endif
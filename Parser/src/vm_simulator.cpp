@@ -1,109 +1,876 @@
 #include "vm_simulator.hpp"
+#include "bytecode_verifier.hpp"
+#include "superinstructions.hpp"
+#include "vm_snapshot.hpp"
+#include <algorithm>
 #include <iostream>
 #include <stdexcept>
 #include <iomanip>
+#include <cstring>
+#include <cstdio>
+#include <new>
+#include <string>
 
-VMSimulator::VMSimulator(const std::vector<Instruction>& instructions) : instructions(instructions) {
+namespace {
+
+// Number of operands printed in the step listing
+int operandCount(OpCode op) {
+    switch (op) {
+        case OpCode::INVOKE: case OpCode::ILOAD2_IADD: case OpCode::IINC:
+            return 2;
+        case OpCode::IADD_K: case OpCode::ISUB_K:
+        case OpCode::ICMP_EQ_JF: case OpCode::ICMP_LT_JF: case OpCode::ICMP_GT_JF:
+        case OpCode::ICMP_EQ_JT: case OpCode::ICMP_LT_JT: case OpCode::ICMP_GT_JT:
+            return 1;
+        case OpCode::ICONST: case OpCode::ILOAD: case OpCode::ISTORE:
+        case OpCode::JMP: case OpCode::JMP_IF_FALSE: case OpCode::JNZ:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// Only names up to HALT come from the parser; the rest are superinstructions
+bool lookupOpcode(const std::string& name, OpCode& op) {
+    for (size_t i = 0; i < static_cast<size_t>(OpCode::HALT); ++i) {
+        if (name == opcodeName(static_cast<OpCode>(i))) {
+            op = static_cast<OpCode>(i);
+            return true;
+        }
+    }
+    if (name == "LOAD") { op = OpCode::ILOAD; return true; }
+    if (name == "STORE") { op = OpCode::ISTORE; return true; }
+    if (name == "JMP_IF_ZERO") { op = OpCode::JMP_IF_FALSE; return true; }
+    if (name == "ICMP") { op = OpCode::ICMP_EQ; return true; }
+    return false;
+}
+
+// FNV-1a over the decoded program before fusion, so it depends only on the
+// bytecode
+uint64_t hashProgram(const std::vector<DecodedInstr>& code, size_t entry) {
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](uint32_t word) {
+        for (int i = 0; i < 4; ++i) {
+            hash ^= (word >> (8 * i)) & 0xFF;
+            hash *= 1099511628211ull;
+        }
+    };
+    mix(static_cast<uint32_t>(entry));
+    for (const auto& d : code) {
+        mix(static_cast<uint32_t>(d.op));
+        mix(static_cast<uint32_t>(d.a));
+        mix(static_cast<uint32_t>(d.b));
+    }
+    return hash;
+}
+
+} // namespace
+
+VMSimulator::VMSimulator(const std::vector<Instruction>& instructions, bool fuse_superinstructions) {
+    dispatch_mode = VM_HAS_COMPUTED_GOTO ? DispatchMode::Threaded : DispatchMode::Switch;
+    trace_mode = TraceMode::Listing;
+    output = &std::cout;
+    max_call_depth = kMaxCallDepth;
+    load(instructions, fuse_superinstructions);
+}
+
+void VMSimulator::load(const std::vector<Instruction>& program, bool fuse_superinstructions) {
     pc = 0;
-    memory.resize(256, 0); // Initialize memory with 256 slots set to zero
+    handlers_bound = false;
+    ran_native = false;
+    jit.clear();
+    jit_error.clear();
+    checkpoint_filename.clear();
+    checkpoint_index = kNoCheckpoint;
+    checkpoint_taken = false;
+    resume_pending = false;
+    entry = 0;
+    frame_slots = 1;
+    stack_depth = 0;
+    call_depth = 0;
+    exit_value = 0;
+    dispatched = 0;
+    fused_saved = 0;
+    heap.assign(4, 0); // Keep address 0 unused so it never names an allocation
+    code.clear();
+    decode(program);
+    if (fuse_superinstructions && trace_mode != TraceMode::Profile) {
+        fuseSuperinstructions(code);
+    }
+    function_names.assign(code.size(), "");
+    function_names[entry] = "main";
+}
+
+// Lowers the Instruction list into `code`. Label pseudo-instructions that
+// main.cpp inserts ("main:", ".global") take no space; "main:" marks the
+// entry point. Jump and call operands are byte offsets into the code
+// section; `cfg` resolves them and they are rewritten here to indices into
+// `code`.
+//
+// Decoding also verifies and bounds the program: local indices are checked
+// once here, BytecodeVerifier proves the operand stack can neither
+// underflow nor outgrow the size it computes, and the operand stack, call
+// stack and frames are allocated up front at that size so the run loop
+// checks no depth and grows them only when recursion nests deeper.
+void VMSimulator::decode(const std::vector<Instruction>& instructions) {
+    cfg = ControlFlowGraph(instructions);
+    code_index.assign(instructions.size() + 1, 0);
+
+    for (size_t i = 0; i < instructions.size(); ++i) {
+        const Instruction& instr = instructions[i];
+        code_index[i] = code.size(); // a label pseudo-instruction maps to what follows it
+        if (instr.name == "main:" || instr.name == "kik:") {
+            entry = code.size();
+            continue;
+        }
+        if (isLabelPseudo(instr.name)) {
+            continue;
+        }
+
+        DecodedInstr d{OpCode::HALT, 0, 0, nullptr};
+        if (!lookupOpcode(instr.name, d.op)) {
+            throw std::runtime_error("Simulator cannot decode instruction: " + instr.name);
+        }
+        size_t needed = (encodedSize(instr.name) == 1) ? 0 : (d.op == OpCode::INVOKE ? 2 : 1);
+        if (instr.operands.size() < needed) {
+            throw std::runtime_error("Missing operand for " + instr.name);
+        }
+        if (needed >= 1) d.a = instr.operands[0];
+        if (needed >= 2) d.b = instr.operands[1];
+
+        // Highest local slot touched decides the frame size
+        int last_slot = -1;
+        if (d.op == OpCode::ILOAD || d.op == OpCode::ISTORE) last_slot = d.a;
+        if (d.op == OpCode::INVOKE) last_slot = d.b - 1;
+        if (last_slot >= static_cast<int>(kFrameSlots) || ((d.op == OpCode::ILOAD || d.op == OpCode::ISTORE) && d.a < 0)) {
+            throw std::runtime_error("Local index out of range in " + instr.name + " " + std::to_string(d.a));
+        }
+        if (last_slot + 1 > static_cast<int>(frame_slots)) frame_slots = last_slot + 1;
+        code.push_back(d);
+    }
+
+    // Running off the end of the code stops the machine like the generator's
+    // default epilogue does; an explicit HALT saves a bounds check per step.
+    code_index[instructions.size()] = code.size();
+    code.push_back(DecodedInstr{OpCode::HALT, 0, 0, nullptr});
+
+    for (size_t i = 0; i < instructions.size(); ++i) {
+        if (cfg.targetOf(i) >= 0) code[code_index[i]].a = static_cast<int>(code_index[cfg.targetOf(i)]);
+    }
+    program_hash = hashProgram(code, entry);
+
+    BytecodeVerifier verifier(instructions, cfg, kInitialCallDepth);
+    stack_height.assign(code.size(), -1);
+    for (size_t i = 0; i < instructions.size(); ++i) {
+        if (!isLabelPseudo(instructions[i].name)) stack_height[code_index[i]] = verifier.heightAt(i);
+    }
+    size_t max_calls = verifier.maxCallDepth();
+    stack_per_call = verifier.stackPerCall();
+    recursive = verifier.isRecursive();
+    operand_stack.assign(verifier.maxStack() + 1, 0); // slot 0 stays unused, see execute()
+    call_stack.assign(max_calls, 0);
+    memory.assign((max_calls + 1) * frame_slots, 0);
+}
+
+// Makes room for `calls` nested calls, doubling the call stack so deep
+// recursion grows it a logarithmic number of times. The operand stack
+// grows with it so the verifier's bound, and the unchecked pushes that rely
+// on it, still hold.
+void VMSimulator::reserveCalls(size_t calls) {
+    if (calls <= call_stack.size()) return;
+    if (calls > max_call_depth) throw std::runtime_error("Call stack overflow");
+    size_t capacity = std::max(call_stack.size(), kInitialCallDepth);
+    while (capacity < calls) capacity *= 2;
+    capacity = std::min(capacity, max_call_depth);
+    try {
+        operand_stack.resize(operand_stack.size() + (capacity - call_stack.size()) * stack_per_call, 0);
+        memory.resize((capacity + 1) * frame_slots, 0);
+        call_stack.resize(capacity, 0);
+    } catch (const std::bad_alloc&) {
+        throw std::runtime_error("Call stack overflow");
+    }
 }
 
-void VMSimulator::printStack() const {
-    // This helper function remains the same as before
+void VMSimulator::setMaxCallDepth(size_t depth) {
+    max_call_depth = depth;
+}
+
+void VMSimulator::setCheckpoint(const std::string& filename, uint32_t offset) {
+    int at = cfg.indexAtOffset(offset);
+    if (at < 0) {
+        throw std::runtime_error("Checkpoint offset " + std::to_string(offset) + " is not an instruction boundary");
+    }
+    if (checkpoint_index != kNoCheckpoint) code[checkpoint_index] = checkpoint_saved;
+    size_t index = code_index[at];
+
+    // A superinstruction running through `index` would step over it, so the
+    // ones that cover it go back to their first original instruction
+    for (size_t i = index >= 3 ? index - 3 : 0; i < index; ++i) {
+        if (i + superinstructionLength(code[i].op) > index) code[i].op = unfusedOpcode(code[i].op);
+    }
+    checkpoint_filename = filename;
+    checkpoint_index = index;
+    checkpoint_saved = code[index];
+    code[index].op = OpCode::CHECKPOINT;
+    handlers_bound = false;
+}
+
+bool VMSimulator::checkpointTaken() const {
+    return checkpoint_taken;
+}
+
+// Called by the CHECKPOINT handler with pc and the stacks written back.
+// The instruction underneath goes back in place; the handler rebinds it.
+void VMSimulator::takeCheckpoint() {
+    VMSnapshotHeader header;
+    std::memcpy(header.magic, VMSnapshot::kMagic, sizeof(header.magic));
+    header.program_hash = program_hash;
+    header.dispatched = dispatched;
+    header.fused_saved = fused_saved;
+    header.pc = static_cast<uint32_t>(pc);
+    header.frame_slots = static_cast<uint32_t>(frame_slots);
+    header.stack_depth = static_cast<uint32_t>(stack_depth);
+    header.call_depth = static_cast<uint32_t>(call_depth);
+    header.heap_bytes = static_cast<uint32_t>(heap.size());
+    header.reserved = 0;
+    code[checkpoint_index] = checkpoint_saved;
+    checkpoint_index = kNoCheckpoint;
+    VMSnapshot::write(checkpoint_filename, header, operand_stack.data(), call_stack.data(), memory.data(), heap.data());
+    checkpoint_taken = true;
+}
+
+void VMSimulator::restoreSnapshot(const std::string& filename) {
+    VMSnapshot snapshot(filename);
+    const VMSnapshotHeader& h = snapshot.header();
+    if (h.program_hash != program_hash) {
+        throw std::runtime_error("Snapshot " + filename + " was taken from different bytecode");
+    }
+    bool fits = h.frame_slots == frame_slots && h.pc < code.size() && h.call_depth <= max_call_depth;
+    if (fits) reserveCalls(h.call_depth);
+    fits = fits && h.stack_depth < operand_stack.size() && h.call_depth <= call_stack.size();
+
+    // The run after a restore is unchecked too, so the stack must be what
+    // the verifier expects there: each caller's height below its INVOKE
+    // plus the height at pc
+    auto opAt = [this](size_t index) { return index == checkpoint_index ? checkpoint_saved.op : code[index].op; };
+    int64_t expected = fits ? stack_height[h.pc] : -1;
+    for (uint32_t i = 0; fits && i < h.call_depth; ++i) {
+        uint32_t ret = snapshot.calls()[i];
+        if (ret == 0 || ret >= code.size() || opAt(ret - 1) != OpCode::INVOKE || stack_height[ret - 1] < 0) {
+            fits = false;
+        } else {
+            expected += stack_height[ret - 1] - code[ret - 1].b;
+        }
+    }
+    if (stack_height.empty() || expected != static_cast<int64_t>(h.stack_depth) || stack_height[h.pc] < 0) fits = false;
+    if (!fits) {
+        throw std::runtime_error("Snapshot " + filename + " does not fit the program");
+    }
+
+    std::memcpy(operand_stack.data(), snapshot.stack(), (h.stack_depth + 1) * sizeof(int));
+    std::memcpy(call_stack.data(), snapshot.calls(), h.call_depth * sizeof(uint32_t));
+    std::memcpy(memory.data(), snapshot.frames(), (h.call_depth + 1) * frame_slots * sizeof(int));
+    heap.assign(snapshot.heap(), snapshot.heap() + h.heap_bytes);
+    pc = h.pc;
+    stack_depth = h.stack_depth;
+    call_depth = h.call_depth;
+    dispatched = h.dispatched;
+    fused_saved = h.fused_saved;
+    resume_pending = true;
+    jit.clear(); // recompiled with the resume point as an entry
+}
+
+uint64_t VMSimulator::getProgramHash() const {
+    return program_hash;
+}
+
+int VMSimulator::getExitValue() const {
+    return exit_value;
+}
+
+uint64_t VMSimulator::getInstructionCount() const {
+    return dispatched + fused_saved;
+}
+
+uint64_t VMSimulator::getDispatchesEliminated() const {
+    return fused_saved;
+}
+
+int32_t VMSimulator::heapAlloc(int32_t bytes) {
+    if (bytes < 0) throw std::runtime_error("Negative allocation size");
+    int32_t addr = static_cast<int32_t>(heap.size());
+    heap.resize(heap.size() + ((bytes + 3) & ~3), 0); // keep allocations word aligned
+    return addr;
+}
+
+uint8_t* VMSimulator::heapAt(int32_t addr, int32_t bytes) {
+    if (addr <= 0 || static_cast<size_t>(addr) + bytes > heap.size()) {
+        throw std::runtime_error("Heap access out of bounds");
+    }
+    return heap.data() + addr;
+}
+
+// `sp` and `tos` describe the stack the way execute() holds it: the values
+// below the top live in operand_stack[1 .. sp - base - 1] and the top is in
+// `tos`.
+void VMSimulator::printStack(const int* sp, int tos) const {
     std::cout << "[ ";
-    std::stack<int> temp = vm_stack;
-    std::vector<int> contents;
-    while (!temp.empty()) {
-        contents.push_back(temp.top());
-        temp.pop();
+    const int* base = operand_stack.data();
+    for (const int* p = base + 1; p < sp; ++p) {
+        std::cout << *p << " ";
     }
-    for (int i = contents.size() - 1; i >= 0; --i) {
-        std::cout << contents[i] << " ";
+    if (sp > base) {
+        std::cout << tos << " ";
     }
     std::cout << "<-- top ]" << std::endl;
 }
 
+void VMSimulator::setDispatchMode(DispatchMode mode) {
+#if !VM_HAS_JIT
+    if (mode == DispatchMode::Jit) mode = DispatchMode::Threaded;
+#endif
+#if !VM_HAS_COMPUTED_GOTO
+    if (mode == DispatchMode::Threaded) mode = DispatchMode::Switch; // labels-as-values unavailable in this build
+#endif
+    dispatch_mode = mode;
+}
+
+VMSimulator::DispatchMode VMSimulator::getDispatchMode() const {
+    return dispatch_mode;
+}
+
+bool VMSimulator::ranNative() const {
+    return ran_native;
+}
+
+const VMJit& VMSimulator::getJit() const {
+    return jit;
+}
+
+void VMSimulator::setTraceMode(TraceMode mode, const std::string& dump_filename) {
+    trace_mode = mode;
+    trace_filename = dump_filename;
+    if (mode == TraceMode::Profile) {
+        // A fused dispatch would be counted once, against its first
+        // instruction, so profiles run the program as written
+        for (auto& d : code) d.op = unfusedOpcode(d.op);
+        if (checkpoint_index != kNoCheckpoint) checkpoint_saved.op = unfusedOpcode(checkpoint_saved.op);
+        handlers_bound = false;
+    }
+}
+
+const TraceRing& VMSimulator::getTrace() const {
+    return trace;
+}
+
+void VMSimulator::setOutput(std::ostream& out) {
+    output = &out;
+}
+
+void VMSimulator::setSymbols(const std::vector<SymbolEntry>& symbols) {
+    for (const auto& sym : symbols) {
+        if (!sym.defined || sym.type != 0) continue; // functions are defined TEXT symbols
+        int at = cfg.indexAtOffset(sym.address);
+        if (at >= 0) function_names[code_index[at]] = sym.name;
+    }
+}
+
+const VMProfile& VMSimulator::getProfile() const {
+    return profile;
+}
+
+void VMSimulator::writeProfile(std::ostream& report, std::ostream& collapsed) const {
+    profile.writeReport(report, code, entry, function_names);
+    profile.writeCollapsed(collapsed, entry, function_names);
+}
+
+void VMSimulator::printStep(const DecodedInstr* ip) const {
+    if (ip->op == OpCode::HALT) return;
+    char text[40];
+    switch (operandCount(ip->op)) {
+        case 0: std::snprintf(text, sizeof(text), "%s", opcodeName(ip->op)); break;
+        case 1: std::snprintf(text, sizeof(text), "%s %d", opcodeName(ip->op), ip->a); break;
+        default: std::snprintf(text, sizeof(text), "%s %d %d", opcodeName(ip->op), ip->a, ip->b); break;
+    }
+    std::cout << "PC: " << std::setw(3) << (ip - code.data()) << " | Executing: " << std::left << std::setw(20) << text;
+}
+
 void VMSimulator::run() {
-    std::cout << "\n--- VM Simulation Start ---\n";
-    std::cout << "Initial Stack: ";
-    printStack();
-    std::cout << "---------------------------\n";
-
-    while (pc < instructions.size()) {
-        const auto& instr = instructions[pc];
-        std::cout << "PC: " << std::setw(3) << pc << " | Executing: " << std::left << std::setw(20) << (instr.name + (instr.operands.empty() ? "" : " " + std::to_string(instr.operands[0])) );
-
-        if (instr.name == "ICONST") {
-            vm_stack.push(instr.operands[0]);
-        } else if (instr.name == "IADD") {
-            if (vm_stack.size() < 2) throw std::runtime_error("Stack underflow for IADD");
-            int b = vm_stack.top(); vm_stack.pop();
-            int a = vm_stack.top(); vm_stack.pop();
-            vm_stack.push(a + b);
-        } else if (instr.name == "ISUB") {
-            if (vm_stack.size() < 2) throw std::runtime_error("Stack underflow for ISUB");
-            int b = vm_stack.top(); vm_stack.pop();
-            int a = vm_stack.top(); vm_stack.pop();
-            vm_stack.push(a - b);
-        } else if (instr.name == "IMUL") {
-            if (vm_stack.size() < 2) throw std::runtime_error("Stack underflow for IMUL");
-            int b = vm_stack.top(); vm_stack.pop();
-            int a = vm_stack.top(); vm_stack.pop();
-            vm_stack.push(a * b);
-        } else if (instr.name == "IDIV") {
-            if (vm_stack.size() < 2) throw std::runtime_error("Stack underflow for IDIV");
-            int b = vm_stack.top(); vm_stack.pop();
-            if (b == 0) throw std::runtime_error("Division by zero");
-            int a = vm_stack.top(); vm_stack.pop();
-            vm_stack.push(a / b);
-        } else if (instr.name == "POP") {
-            if (vm_stack.empty()) throw std::runtime_error("Stack underflow for POP");
-            vm_stack.pop();
-        } else if (instr.name == "DUP") {
-            if (vm_stack.empty()) throw std::runtime_error("Stack underflow for DUP");
-            vm_stack.push(vm_stack.top());
-        } else if (instr.name == "ICMP") {
-            if (vm_stack.size() < 2) throw std::runtime_error("Stack underflow for ICMP");
-            int b = vm_stack.top(); vm_stack.pop();
-            int a = vm_stack.top(); vm_stack.pop();
-            vm_stack.push((a == b) ? 1 : 0);
-        } else if (instr.name == "LOAD") {
-            int var_index = instr.operands[0];
-            if (var_index >= memory.size()) throw std::runtime_error("Memory access out of bounds for LOAD");
-            vm_stack.push(memory[var_index]);
-        } else if (instr.name == "STORE") {
-            if (vm_stack.empty()) throw std::runtime_error("Stack underflow for STORE");
-            int val = vm_stack.top(); vm_stack.pop();
-            int var_index = instr.operands[0];
-            if (var_index >= memory.size()) throw std::runtime_error("Memory access out of bounds for STORE");
-            memory[var_index] = val;
-        } else if (instr.name == "JMP") {
-            pc = instr.operands[0];
-            printStack(); continue;
-        } else if (instr.name == "JMP_IF_ZERO") {
-            if (vm_stack.empty()) throw std::runtime_error("Stack underflow for JMP_IF_ZERO");
-            int val = vm_stack.top(); vm_stack.pop();
-            if (val == 0) {
-                pc = instr.operands[0];
-                printStack(); continue;
+    bool listing = (trace_mode == TraceMode::Listing);
+    if (listing) {
+        std::cout << "\n--- VM Simulation Start ---\n";
+        std::cout << "Initial Stack: ";
+        printStack(operand_stack.data() + stack_depth, operand_stack[stack_depth]);
+        std::cout << "---------------------------\n";
+    }
+
+    if (!resume_pending) pc = entry;
+    resume_pending = false;
+    try {
+        switch (trace_mode) {
+            case TraceMode::Listing: executeTraced<TraceMode::Listing>(); break;
+            case TraceMode::Quiet:
+                if (dispatch_mode == DispatchMode::Jit && checkpoint_index == kNoCheckpoint && executeNative()) break;
+                executeTraced<TraceMode::Quiet>();
+                break;
+            case TraceMode::Ring: executeTraced<TraceMode::Ring>(); break;
+            case TraceMode::Profile:
+                profile.reset(code.size());
+                executeTraced<TraceMode::Profile>();
+                break;
+        }
+    } catch (const std::runtime_error&) {
+        // The ring is most useful exactly when the program fails
+        if (trace_mode == TraceMode::Ring && !trace_filename.empty()) trace.dump(trace_filename);
+        throw;
+    }
+    if (trace_mode == TraceMode::Ring && !trace_filename.empty()) trace.dump(trace_filename);
+    if (listing) std::cout << "--- VM Simulation End ---\n";
+}
+
+template <VMSimulator::TraceMode Mode>
+void VMSimulator::executeTraced() {
+    if (dispatch_mode != DispatchMode::Switch) {
+        execute<true, Mode>();
+    } else {
+        execute<false, Mode>();
+    }
+}
+
+// Compiles the program on first use; returns false to leave the run to the
+// interpreter. Functions start at the entry, at named TEXT symbols, at
+// INVOKE targets and where a restored snapshot resumes. Native code keeps
+// return addresses on the native stack, so a snapshot taken inside a call
+// resumes in the interpreter.
+bool VMSimulator::executeNative() {
+    if (call_depth != 0) return false;
+    if (!jit.isCompiled()) {
+        std::vector<bool> function_starts(code.size(), false);
+        function_starts[entry] = true;
+        function_starts[pc] = true;
+        for (size_t i = 0; i < code.size(); ++i) {
+            if (!function_names[i].empty()) function_starts[i] = true;
+            if (code[i].op == OpCode::INVOKE) function_starts[code[i].a] = true;
+        }
+        if (!jit.compile(code, function_starts, frame_slots)) return false;
+    }
+    // The native stack cannot move once calls are on it, so it is sized
+    // for the deepest nesting the run may reach
+    if (!jit.reserveCalls(recursive ? max_call_depth : call_stack.size())) return false;
+
+    VMJitContext ctx;
+    ctx.sp = operand_stack.data() + stack_depth;
+    ctx.stack_base = operand_stack.data();
+    ctx.stack_limit = operand_stack.data() + operand_stack.size() - 1;
+    ctx.call_depth = static_cast<uint32_t>(call_depth);
+    ctx.call_limit = static_cast<uint32_t>(call_stack.size());
+    ctx.executed = 0;
+    ctx.stop_index = static_cast<uint32_t>(pc);
+    ctx.saved_rsp = nullptr;
+    ctx.fallback = &VMSimulator::jitFallback;
+    ctx.grow = &VMSimulator::jitGrow;
+    ctx.locals = nullptr;
+    ctx.host = this;
+    int status = jit.run(ctx, memory.data() + call_depth * frame_slots, pc);
+    ran_native = true;
+
+    stack_depth = static_cast<size_t>(ctx.sp - operand_stack.data());
+    call_depth = ctx.call_depth;
+    pc = ctx.stop_index;
+    dispatched += ctx.executed;
+    switch (status) {
+        case VMJit::kExited:
+            exit_value = stack_depth > 0 ? operand_stack[stack_depth] : 0;
+            return true;
+        case VMJit::kStackUnderflow:
+            throw std::runtime_error(std::string("Stack underflow for ") + opcodeName(code[pc].op));
+        case VMJit::kStackOverflow:
+            throw std::runtime_error("Operand stack overflow");
+        case VMJit::kCallOverflow:
+            throw std::runtime_error("Call stack overflow");
+        case VMJit::kDivisionByZero:
+            throw std::runtime_error("Division by zero");
+        default:
+            throw std::runtime_error(jit_error);
+    }
+}
+
+// Called from native code for the instructions the JIT leaves to the
+// interpreter. Exceptions must not unwind through JIT frames, so failures
+// are returned and rethrown by executeNative().
+int VMSimulator::jitFallback(VMJitContext* ctx, uint32_t index) {
+    VMSimulator* vm = static_cast<VMSimulator*>(ctx->host);
+    try {
+        int* sp = ctx->sp;
+        int tos = *sp;
+        vm->runtimeOp(vm->code[index], sp, tos);
+        *sp = tos;
+        ctx->sp = sp;
+        return 0;
+    } catch (const std::runtime_error& e) {
+        vm->jit_error = e.what();
+        return 1;
+    }
+}
+
+// Called from native code when INVOKE finds the call stack full. The
+// stacks may move, so the pointers native code holds are rebased.
+int VMSimulator::jitGrow(VMJitContext* ctx) {
+    VMSimulator* vm = static_cast<VMSimulator*>(ctx->host);
+    size_t height = static_cast<size_t>(ctx->sp - ctx->stack_base);
+    size_t frame = static_cast<size_t>(ctx->locals - vm->memory.data());
+    try {
+        vm->reserveCalls(static_cast<size_t>(ctx->call_depth) + 1);
+    } catch (const std::runtime_error&) {
+        return 1;
+    }
+    ctx->stack_base = vm->operand_stack.data();
+    ctx->stack_limit = ctx->stack_base + vm->operand_stack.size() - 1;
+    ctx->sp = ctx->stack_base + height;
+    ctx->call_limit = static_cast<uint32_t>(vm->call_stack.size());
+    ctx->locals = vm->memory.data() + frame;
+    return 0;
+}
+
+// Heap and print instructions, shared by execute() and JIT-compiled code.
+// `sp` and `tos` hold the stack as in execute().
+void VMSimulator::runtimeOp(const DecodedInstr& d, int*& sp, int& tos) {
+    const int* stack_base = operand_stack.data();
+    int needed = (d.op == OpCode::SET_ELEM || d.op == OpCode::SET_CHAR) ? 3
+               : (d.op == OpCode::GET_ELEM || d.op == OpCode::GET_CHAR) ? 2 : 1;
+    if (sp < stack_base + needed) throw std::runtime_error(std::string("Stack underflow for ") + opcodeName(d.op));
+
+    switch (d.op) {
+        case OpCode::NEW_ARRAY:
+            tos = heapAlloc(tos * 4);
+            break;
+        case OpCode::NEW_STRING:
+            tos = heapAlloc(tos + 1);
+            break;
+        case OpCode::SET_ELEM: {
+            int value = tos;
+            std::memcpy(heapAt(sp[-2] + sp[-1] * 4, 4), &value, 4);
+            sp -= 3;
+            tos = *sp;
+            break;
+        }
+        case OpCode::SET_CHAR:
+            *heapAt(sp[-2] + sp[-1], 1) = static_cast<uint8_t>(tos);
+            sp -= 3;
+            tos = *sp;
+            break;
+        case OpCode::GET_ELEM: {
+            int value;
+            std::memcpy(&value, heapAt(sp[-1] + tos * 4, 4), 4);
+            --sp;
+            tos = value;
+            break;
+        }
+        case OpCode::GET_CHAR:
+            tos = static_cast<int8_t>(*heapAt(sp[-1] + tos, 1)); // lb sign-extends
+            --sp;
+            break;
+        case OpCode::PRINT_I:
+            *output << tos;
+            tos = *--sp;
+            break;
+        case OpCode::PRINT_S: {
+            int addr = tos;
+            for (const uint8_t* c = heapAt(addr, 1); *c != 0; c = heapAt(++addr, 1)) {
+                *output << static_cast<char>(*c);
             }
-        } else if (instr.name == "INVOKE") {
-            call_stack.push(pc + 1);
-            pc = instr.operands[0];
-            printStack(); continue;
-        } else if (instr.name == "RET") {
-            if (call_stack.empty()) {
-                std::cout << "--- VM Simulation End ---\n";
-                return;
+            tos = *--sp;
+            break;
+        }
+        default:
+            throw std::runtime_error(std::string("Not a runtime instruction: ") + opcodeName(d.op));
+    }
+}
+
+// The handlers are written once and instantiated twice. With Threaded set,
+// every decoded instruction carries the address of its handler label and
+// each handler ends in its own indirect jump to the next one, so the branch
+// predictor sees one jump site per opcode instead of the single switch.
+// Without it, handlers jump back to a shared switch.
+#if VM_HAS_COMPUTED_GOTO
+#define VM_CASE(op) case OpCode::op: vm_op_##op:
+#else
+#define VM_CASE(op) case OpCode::op:
+#endif
+
+// Mode is a template argument, so Quiet builds carry no tracing code at all
+#define VM_DISPATCH()                                   \
+    do {                                                \
+        if (Mode == TraceMode::Listing) printStep(ip);  \
+        if (Mode == TraceMode::Ring) {                  \
+            trace.record(static_cast<uint32_t>(ip - code.data()), static_cast<uint32_t>(ip->op), \
+                         sp > stack_base ? tos : 0, static_cast<uint32_t>(sp - stack_base)); \
+        }                                               \
+        if (Mode == TraceMode::Profile) {               \
+            ++pc_counts[ip - code.data()];              \
+            if (sp > deepest) deepest = sp;             \
+        }                                               \
+        ++dispatched;                                   \
+        if (Threaded) VM_GOTO_HANDLER(); else goto dispatch_switch; \
+    } while (0)
+
+// Finish the current instruction and continue at `ip`
+#define VM_NEXT()                                       \
+    do {                                                \
+        if (Mode == TraceMode::Listing) printStack(sp, tos); \
+        VM_DISPATCH();                                  \
+    } while (0)
+
+// decode() only accepts programs the BytecodeVerifier passed, and sizes the
+// operand stack to its bound, so these checks cannot fire and are left out.
+// Build with -DVM_CHECKED_STACK to put them back when changing the verifier.
+// Stack depth is `sp - stack_base`, so both checks are a pointer compare.
+#ifdef VM_CHECKED_STACK
+#define VM_NEED(n)                                      \
+    do {                                                \
+        if (sp < stack_base + (n)) throw std::runtime_error(std::string("Stack underflow for ") + opcodeName(ip->op)); \
+    } while (0)
+#define VM_CHECK_PUSH() if (sp >= stack_limit) throw std::runtime_error("Operand stack overflow")
+#else
+#define VM_NEED(n) do {} while (0)
+#define VM_CHECK_PUSH() (void)stack_limit
+#endif
+
+#define VM_PUSH(value)                                  \
+    do {                                                \
+        VM_CHECK_PUSH();                                \
+        *sp++ = tos;                                    \
+        tos = (value);                                  \
+    } while (0)
+
+#define VM_DROP() (tos = *--sp)
+
+// Pops b (the top) and replaces a (under it) with `expr`
+#define VM_BINARY(expr)                                 \
+    do {                                                \
+        VM_NEED(2);                                     \
+        int b = tos;                                    \
+        int a = *--sp;                                  \
+        tos = (expr);                                   \
+    } while (0)
+
+template <bool Threaded, VMSimulator::TraceMode Mode>
+void VMSimulator::execute() {
+#if VM_HAS_COMPUTED_GOTO
+#define VM_GOTO_HANDLER() goto *ip->handler
+    static const void* const kHandlers[] = {
+#define VM_OPCODE_LABEL(op, name) &&vm_op_##op,
+        VM_OPCODES(VM_OPCODE_LABEL)
+#undef VM_OPCODE_LABEL
+    };
+    if (Threaded && !handlers_bound) {
+        for (auto& d : code) d.handler = kHandlers[static_cast<size_t>(d.op)];
+        handlers_bound = true;
+    }
+#else
+#define VM_GOTO_HANDLER() goto dispatch_switch
+#endif
+
+    // The top of the operand stack is cached in `tos`; slot 0 of
+    // operand_stack is a dummy so pushing onto an empty stack and popping
+    // the last value need no special case.
+    int* stack_base = operand_stack.data();
+    int* stack_limit = stack_base + operand_stack.size() - 1;
+    int* sp = stack_base + stack_depth;
+    int tos = *sp;
+    uint32_t* call_base = call_stack.data();
+    uint32_t* call_limit = call_base + call_stack.size();
+    uint32_t* csp = call_base + call_depth;
+    int* locals = memory.data() + call_depth * frame_slots;
+    uint64_t* const pc_counts = profile.pc_counts.data(); // Profile mode only
+    const int* deepest = sp;
+
+    const DecodedInstr* ip = code.data() + pc;
+    VM_DISPATCH();
+
+dispatch_switch:
+    switch (ip->op) {
+        VM_CASE(ICONST)
+            VM_PUSH(ip->a);
+            ++ip; VM_NEXT();
+        VM_CASE(IADD)
+            VM_BINARY(a + b);
+            ++ip; VM_NEXT();
+        VM_CASE(ISUB)
+            VM_BINARY(a - b);
+            ++ip; VM_NEXT();
+        VM_CASE(IMUL)
+            VM_BINARY(a * b);
+            ++ip; VM_NEXT();
+        VM_CASE(IDIV)
+            VM_NEED(2);
+            if (tos == 0) throw std::runtime_error("Division by zero");
+            VM_BINARY(a / b);
+            ++ip; VM_NEXT();
+        VM_CASE(POP)
+            VM_NEED(1);
+            VM_DROP();
+            ++ip; VM_NEXT();
+        VM_CASE(DUP)
+            VM_NEED(1);
+            VM_PUSH(tos);
+            ++ip; VM_NEXT();
+        VM_CASE(ICMP_EQ)
+            VM_BINARY(a == b ? 1 : 0);
+            ++ip; VM_NEXT();
+        VM_CASE(ICMP_LT)
+            VM_BINARY(a < b ? 1 : 0);
+            ++ip; VM_NEXT();
+        VM_CASE(ICMP_GT)
+            VM_BINARY(a > b ? 1 : 0);
+            ++ip; VM_NEXT();
+        VM_CASE(ILOAD)
+            VM_PUSH(locals[ip->a]);
+            ++ip; VM_NEXT();
+        VM_CASE(ISTORE)
+            VM_NEED(1);
+            locals[ip->a] = tos;
+            VM_DROP();
+            ++ip; VM_NEXT();
+        VM_CASE(JMP)
+            ip = code.data() + ip->a;
+            VM_NEXT();
+        VM_CASE(JMP_IF_FALSE) {
+            VM_NEED(1);
+            int val = tos;
+            VM_DROP();
+            ip = (val == 0) ? code.data() + ip->a : ip + 1;
+            VM_NEXT();
+        }
+        VM_CASE(JNZ) {
+            VM_NEED(1);
+            int val = tos;
+            VM_DROP();
+            ip = (val != 0) ? code.data() + ip->a : ip + 1;
+            VM_NEXT();
+        }
+        VM_CASE(INVOKE) {
+            VM_NEED(ip->b);
+            if (csp >= call_limit) {
+                // Grow everything; the pointers into it move
+                size_t height = static_cast<size_t>(sp - stack_base);
+                size_t depth = static_cast<size_t>(csp - call_base);
+                size_t deep = static_cast<size_t>(deepest - stack_base);
+                reserveCalls(depth + 1);
+                stack_base = operand_stack.data();
+                stack_limit = stack_base + operand_stack.size() - 1;
+                sp = stack_base + height;
+                deepest = stack_base + deep;
+                call_base = call_stack.data();
+                call_limit = call_base + call_stack.size();
+                csp = call_base + depth;
+                locals = memory.data() + depth * frame_slots;
+            }
+            if (Mode == TraceMode::Profile) profile.enter(static_cast<uint32_t>(ip->a), dispatched + fused_saved);
+            *csp++ = static_cast<uint32_t>(ip - code.data() + 1);
+            locals += frame_slots;
+            // Arguments become the callee's first locals, the last pushed in the highest slot
+            for (int i = ip->b - 1; i >= 0; --i) {
+                locals[i] = tos;
+                VM_DROP();
+            }
+            ip = code.data() + ip->a;
+            VM_NEXT();
+        }
+        VM_CASE(RET)
+            if (csp == call_base) {
+                exit_value = (sp > stack_base) ? tos : 0;
+                goto done;
             }
-            pc = call_stack.top();
-            call_stack.pop();
-            printStack(); continue;
+            if (Mode == TraceMode::Profile) profile.leave(dispatched + fused_saved);
+            ip = code.data() + *--csp;
+            locals -= frame_slots;
+            VM_NEXT();
+        VM_CASE(NEW_ARRAY)
+        VM_CASE(NEW_STRING)
+        VM_CASE(SET_ELEM)
+        VM_CASE(SET_CHAR)
+        VM_CASE(GET_ELEM)
+        VM_CASE(GET_CHAR)
+        VM_CASE(PRINT_I)
+        VM_CASE(PRINT_S)
+            runtimeOp(*ip, sp, tos);
+            ++ip; VM_NEXT();
+        VM_CASE(IADD_K)
+            VM_NEED(1);
+            tos += ip->a;
+            fused_saved += 1;
+            ip += 2; VM_NEXT();
+        VM_CASE(ISUB_K)
+            VM_NEED(1);
+            tos -= ip->a;
+            fused_saved += 1;
+            ip += 2; VM_NEXT();
+        VM_CASE(ILOAD2_IADD)
+            VM_PUSH(locals[ip->a] + locals[ip->b]);
+            fused_saved += 2;
+            ip += 3; VM_NEXT();
+        VM_CASE(IINC)
+            locals[ip->a] += ip->b;
+            fused_saved += 3;
+            ip += 4; VM_NEXT();
+#define VM_FUSED_COMPARE_BRANCH(op, cmp, jump_when)                         \
+        VM_CASE(op) {                                                       \
+            VM_NEED(2);                                                     \
+            bool taken = ((sp[-1] cmp tos) == jump_when);                   \
+            --sp;                                                           \
+            VM_DROP();                                                      \
+            ip = taken ? code.data() + ip->a : ip + 2;                      \
+            fused_saved += 1;                                               \
+            VM_NEXT();                                                      \
         }
+        VM_FUSED_COMPARE_BRANCH(ICMP_EQ_JF, ==, false)
+        VM_FUSED_COMPARE_BRANCH(ICMP_LT_JF, <, false)
+        VM_FUSED_COMPARE_BRANCH(ICMP_GT_JF, >, false)
+        VM_FUSED_COMPARE_BRANCH(ICMP_EQ_JT, ==, true)
+        VM_FUSED_COMPARE_BRANCH(ICMP_LT_JT, <, true)
+        VM_FUSED_COMPARE_BRANCH(ICMP_GT_JT, >, true)
+#undef VM_FUSED_COMPARE_BRANCH
+        VM_CASE(CHECKPOINT)
+            // Not a program instruction: save the machine as it stands, put
+            // the instruction underneath back and dispatch it
+            --dispatched;
+            if (Mode == TraceMode::Profile) --pc_counts[ip - code.data()];
+            if (sp > stack_base) *sp = tos;
+            stack_depth = static_cast<size_t>(sp - stack_base);
+            call_depth = static_cast<size_t>(csp - call_base);
+            pc = static_cast<size_t>(ip - code.data());
+            takeCheckpoint();
+#if VM_HAS_COMPUTED_GOTO
+            code[pc].handler = kHandlers[static_cast<size_t>(code[pc].op)];
+#endif
+            VM_DISPATCH();
+        VM_CASE(HALT)
+            --dispatched; // not a program instruction
+            exit_value = (sp > stack_base) ? tos : 0;
+            if (Mode == TraceMode::Listing) std::cout << "-------------------------\n";
+            goto done;
+    }
+#undef VM_GOTO_HANDLER
 
-        printStack();
-        pc++;
+done:
+    // Leave the stack in memory form: the top goes back to its slot
+    if (sp > stack_base) *sp = tos;
+    if (Mode == TraceMode::Listing && ip->op == OpCode::RET) printStack(sp, tos);
+    if (Mode == TraceMode::Profile) {
+        profile.max_stack_depth = static_cast<size_t>(deepest - stack_base);
+        profile.finish(dispatched + fused_saved);
     }
-    std::cout << "-------------------------\n";
-    std::cout << "--- VM Simulation End ---\n";
-}
\ No newline at end of file
+    stack_depth = static_cast<size_t>(sp - stack_base);
+    call_depth = static_cast<size_t>(csp - call_base);
+    pc = static_cast<size_t>(ip - code.data());
+}
+
+#undef VM_CASE
+#undef VM_DISPATCH
+#undef VM_NEXT
+#undef VM_NEED
+#undef VM_CHECK_PUSH
+#undef VM_PUSH
+#undef VM_DROP
+#undef VM_BINARY
@@ -1,25 +1,157 @@
 #ifndef VM_SIMULATOR_HPP
 #define VM_SIMULATOR_HPP
 
+#include "control_flow.hpp"
 #include "parser.hpp"
+#include "symbol_table.hpp"
+#include "vm_jit.hpp"
+#include "vm_opcodes.hpp"
+#include "vm_profiler.hpp"
+#include "vm_trace.hpp"
+#include <string>
 #include <vector>
-#include <stack>
+#include <cstdint>
+#include <ostream>
+
+// Threaded dispatch needs the GCC/Clang labels-as-values extension. Build
+// with -DVM_NO_COMPUTED_GOTO to force the portable switch loop.
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(VM_NO_COMPUTED_GOTO)
+#define VM_HAS_COMPUTED_GOTO 1
+#else
+#define VM_HAS_COMPUTED_GOTO 0
+#endif
 
 class VMSimulator {
 public:
-    VMSimulator(const std::vector<Instruction>& instructions);
+    // Jit compiles the program to native code (see vm_jit.hpp) for Quiet
+    // runs; other trace modes, and builds without VM_HAS_JIT, use Threaded.
+    enum class DispatchMode { Switch, Threaded, Jit };
+    // Listing prints every step and the stack after it; Quiet prints only
+    // the program's own output; Ring is Quiet plus a binary record of each
+    // step in a TraceRing; Profile is Quiet plus the VMProfile counters,
+    // and turns superinstruction fusion off so every opcode and instruction
+    // is counted.
+    enum class TraceMode { Listing, Quiet, Ring, Profile };
+
+    // Unless told otherwise, common instruction sequences are fused into
+    // superinstructions at load time (see superinstructions.hpp). Programs
+    // that fail BytecodeVerifier are rejected with std::runtime_error.
+    VMSimulator(const std::vector<Instruction>& instructions, bool fuse_superinstructions = true);
+    // Replaces the program with `instructions`. Counters, heap and JIT code start over; the operand stack, call stack
+    // and frames keep their storage when it is already large enough, so one
+    // VMSimulator can run many programs without reallocating.
+    void load(const std::vector<Instruction>& instructions, bool fuse_superinstructions = true);
     void run();
 
+    // Threaded is the default where the compiler supports it; requesting it
+    // in a build without VM_HAS_COMPUTED_GOTO keeps the switch loop.
+    void setDispatchMode(DispatchMode mode);
+    DispatchMode getDispatchMode() const;
+    // Whether the last run() executed JIT-compiled code
+    bool ranNative() const;
+    const VMJit& getJit() const;
+
+    // In Ring mode the trace is written to `dump_filename` (when given)
+    // after run() finishes or throws.
+    void setTraceMode(TraceMode mode, const std::string& dump_filename = "");
+    const TraceRing& getTrace() const;
+
+    // Where PRINT_I and PRINT_S write; std::cout unless set. The step
+    // listing always goes to std::cout.
+    void setOutput(std::ostream& out);
+
+    // The first time execution reaches the instruction at byte offset
+    // `offset` of the code section, the machine state is written to
+    // `filename` (see vm_snapshot.hpp) and the run carries on. A run with a
+    // checkpoint pending does not use the JIT.
+    void setCheckpoint(const std::string& filename, uint32_t offset);
+    bool checkpointTaken() const;
+    // The next run() resumes from a snapshot instead of starting at main.
+    // Throws when the snapshot was taken from different bytecode.
+    void restoreSnapshot(const std::string& filename);
+    // Hash of the decoded bytecode that snapshots are checked against
+    uint64_t getProgramHash() const;
+
+    // Names functions in profile output. Symbol addresses are byte offsets
+    // into the code section, as in the .o symbol table.
+    void setSymbols(const std::vector<SymbolEntry>& symbols);
+    const VMProfile& getProfile() const;
+    void writeProfile(std::ostream& report, std::ostream& collapsed) const;
+
+    int getExitValue() const;
+    uint64_t getInstructionCount() const;
+    uint64_t getDispatchesEliminated() const; // by superinstructions during run()
+
+    // Largest local index a program may use, plus one
+    static const size_t kFrameSlots = 256;
+    // Call stack a recursive program starts with; others get exactly the
+    // depth their call graph allows. It doubles, with the frames and the
+    // operand stack, whenever INVOKE finds it full.
+    static const size_t kInitialCallDepth = 1024;
+    // Default for setMaxCallDepth()
+    static const size_t kMaxCallDepth = size_t(1) << 24;
+    // INVOKE nesting beyond `depth` fails with "Call stack overflow"
+    void setMaxCallDepth(size_t depth);
+
 private:
-    void printStack() const;
+    void decode(const std::vector<Instruction>& instructions);
+    template <TraceMode Mode> void executeTraced();
+    template <bool Threaded, TraceMode Mode> void execute();
+    bool executeNative();
+    static int jitFallback(VMJitContext* ctx, uint32_t index);
+    static int jitGrow(VMJitContext* ctx);
+    void reserveCalls(size_t calls);
+    void runtimeOp(const DecodedInstr& d, int*& sp, int& tos);
+    void takeCheckpoint();
+    void printStep(const DecodedInstr* ip) const;
+    void printStack(const int* sp, int tos) const;
+    int32_t heapAlloc(int32_t bytes);
+    uint8_t* heapAt(int32_t addr, int32_t bytes);
+
+    std::vector<DecodedInstr> code; // lowered once from `instructions`
+    size_t entry;                   // index of the first instruction of main
+    DispatchMode dispatch_mode;
+    TraceMode trace_mode;
+    std::string trace_filename;
+    TraceRing trace;
+    std::ostream* output;
+    VMProfile profile;
+    ControlFlowGraph cfg;                    // of the instruction list
+    std::vector<size_t> code_index;          // per entry of the instruction list, plus the end: index into `code`
+    std::vector<int> stack_height;           // per index into `code`: verified height from the function entry, -1 if unreachable
+    std::vector<std::string> function_names; // per index into `code`, set at function starts
+    bool handlers_bound;            // DecodedInstr::handler filled in
+    VMJit jit;
+    bool ran_native;
+    std::string jit_error;          // from a failed jitFallback()
+    uint64_t program_hash;
+    std::string checkpoint_filename;
+    size_t checkpoint_index;        // where CHECKPOINT sits in `code`; kNoCheckpoint when none is pending
+    DecodedInstr checkpoint_saved;  // the instruction it replaced
+    bool checkpoint_taken;
+    bool resume_pending;            // restoreSnapshot() set pc and the stacks
+    static const size_t kNoCheckpoint = static_cast<size_t>(-1);
 
-    const std::vector<Instruction>& instructions;
-    std::stack<int> vm_stack;
+    // Allocated by decode() from bounds on the program, and grown together
+    // by reserveCalls() when a recursive program nests deeper. execute()
+    // works on raw pointers into these and writes the depths back when it
+    // stops.
+    std::vector<int> operand_stack; // slot 0 unused, values from slot 1 up
+    size_t stack_depth;
+    std::vector<uint32_t> call_stack; // return indices for INVOKE and RET
+    size_t call_depth;
+    size_t frame_slots; // locals per frame: highest index the program uses, plus one
+    size_t stack_per_call; // operand stack each further nested call needs
+    bool recursive;        // so call_stack can grow
+    size_t max_call_depth;
 
     // New members for a more complete simulation
-    size_t pc; // Program Counter
-    std::vector<int> memory; // For LOAD and STORE
-    std::stack<size_t> call_stack; // For INVOKE and RET
+    size_t pc; // Program Counter (index into `code`)
+    std::vector<int> memory; // For ILOAD and ISTORE, frame_slots per active frame
+    std::vector<uint8_t> heap; // NEW_ARRAY / NEW_STRING storage, addressed by byte
+    int exit_value;
+    uint64_t dispatched;
+    uint64_t fused_saved; // bytecodes executed inside a superinstruction beyond its first
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,113 @@
+#include "vm_snapshot.hpp"
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define VM_SNAPSHOT_MMAP 1
+#else
+#define VM_SNAPSHOT_MMAP 0
+#endif
+
+const char VMSnapshot::kMagic[8] = {'V', 'M', 'S', 'N', 'A', 'P', '0', '1'};
+
+namespace {
+
+// Byte sizes of the sections after the header
+size_t sectionBytes(const VMSnapshotHeader& h) {
+    return (static_cast<size_t>(h.stack_depth) + 1) * sizeof(int)
+         + static_cast<size_t>(h.call_depth) * sizeof(uint32_t)
+         + (static_cast<size_t>(h.call_depth) + 1) * h.frame_slots * sizeof(int)
+         + h.heap_bytes;
+}
+
+} // namespace
+
+void VMSnapshot::write(const std::string& filename, const VMSnapshotHeader& header, const int* stack,
+                       const uint32_t* calls, const int* frames, const uint8_t* heap) {
+    std::ofstream out(filename, std::ios::binary);
+    if (!out.is_open()) {
+        throw std::runtime_error("Could not open snapshot file: " + filename);
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(stack), (header.stack_depth + 1) * sizeof(int));
+    out.write(reinterpret_cast<const char*>(calls), header.call_depth * sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(frames), (header.call_depth + 1) * header.frame_slots * sizeof(int));
+    out.write(reinterpret_cast<const char*>(heap), header.heap_bytes);
+    if (!out) {
+        throw std::runtime_error("Could not write snapshot file: " + filename);
+    }
+}
+
+VMSnapshot::VMSnapshot(const std::string& filename) : data(nullptr), size(0), mapped(false) {
+#if VM_SNAPSHOT_MMAP
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open snapshot file: " + filename);
+    }
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view != MAP_FAILED) {
+            data = static_cast<const uint8_t*>(view);
+            size = static_cast<size_t>(info.st_size);
+            mapped = true;
+        }
+    }
+    close(fd);
+#endif
+    if (!mapped) {
+        std::ifstream in(filename, std::ios::binary);
+        if (!in.is_open()) {
+            throw std::runtime_error("Could not open snapshot file: " + filename);
+        }
+        buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        data = reinterpret_cast<const uint8_t*>(buffer.data());
+        size = buffer.size();
+    }
+
+    if (size < sizeof(VMSnapshotHeader) || std::memcmp(header().magic, kMagic, sizeof(kMagic)) != 0) {
+        release();
+        throw std::runtime_error("Not a VM snapshot of this version: " + filename);
+    }
+    if (size != sizeof(VMSnapshotHeader) + sectionBytes(header())) {
+        release();
+        throw std::runtime_error("Truncated snapshot file: " + filename);
+    }
+}
+
+VMSnapshot::~VMSnapshot() {
+    release();
+}
+
+void VMSnapshot::release() {
+#if VM_SNAPSHOT_MMAP
+    if (mapped) munmap(const_cast<uint8_t*>(data), size);
+#endif
+    mapped = false;
+}
+
+const VMSnapshotHeader& VMSnapshot::header() const {
+    return *reinterpret_cast<const VMSnapshotHeader*>(data);
+}
+
+const int* VMSnapshot::stack() const {
+    return reinterpret_cast<const int*>(data + sizeof(VMSnapshotHeader));
+}
+
+const uint32_t* VMSnapshot::calls() const {
+    return reinterpret_cast<const uint32_t*>(stack() + header().stack_depth + 1);
+}
+
+const int* VMSnapshot::frames() const {
+    return reinterpret_cast<const int*>(calls() + header().call_depth);
+}
+
+const uint8_t* VMSnapshot::heap() const {
+    return reinterpret_cast<const uint8_t*>(frames() + (header().call_depth + 1) * header().frame_slots);
+}
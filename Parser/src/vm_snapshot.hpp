@@ -0,0 +1,59 @@
+#ifndef VM_SNAPSHOT_HPP
+#define VM_SNAPSHOT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Fixed part of a snapshot file, written as-is in host byte order.
+// `program_hash` identifies the decoded bytecode the state belongs to, so
+// a checkpoint taken from another build of the program is rejected.
+struct VMSnapshotHeader {
+    char magic[8];         // "VMSNAP01"; the digits are the format version
+    uint64_t program_hash;
+    uint64_t dispatched;   // counters of the run up to the checkpoint
+    uint64_t fused_saved;
+    uint32_t pc;           // index into the simulator's decoded code
+    uint32_t frame_slots;
+    uint32_t stack_depth;  // values in operand stack slots 1..stack_depth
+    uint32_t call_depth;
+    uint32_t heap_bytes;
+    uint32_t reserved;
+};
+
+// File layout: the header, then operand stack slots 0..stack_depth (int32),
+// the call stack (uint32 return indices), frames 0..call_depth of locals
+// (int32, frame_slots each) and the heap bytes.
+//
+// Loading maps the file read-only, so restoring costs one copy of each
+// section out of the page cache rather than a parse.
+class VMSnapshot {
+public:
+    static const char kMagic[8];
+
+    static void write(const std::string& filename, const VMSnapshotHeader& header, const int* stack,
+                      const uint32_t* calls, const int* frames, const uint8_t* heap);
+
+    // Throws std::runtime_error when the file cannot be mapped, is not a
+    // snapshot of this format version, or is truncated
+    explicit VMSnapshot(const std::string& filename);
+    ~VMSnapshot();
+    VMSnapshot(const VMSnapshot&) = delete;
+    VMSnapshot& operator=(const VMSnapshot&) = delete;
+
+    const VMSnapshotHeader& header() const;
+    const int* stack() const;
+    const uint32_t* calls() const;
+    const int* frames() const;
+    const uint8_t* heap() const;
+
+private:
+    void release();
+
+    const uint8_t* data;
+    size_t size;
+    bool mapped; // false when the file was read into `buffer` instead
+    std::string buffer;
+};
+
+#endif
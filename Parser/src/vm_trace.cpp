@@ -0,0 +1,58 @@
+#include "vm_trace.hpp"
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+const char kTraceMagic[8] = {'V', 'M', 'T', 'R', 'A', 'C', 'E', '1'};
+}
+
+TraceRing::TraceRing() : records(kRecords), next(0) {}
+
+uint64_t TraceRing::totalRecorded() const {
+    return next;
+}
+
+std::vector<TraceRecord> TraceRing::snapshot() const {
+    size_t count = next < kRecords ? static_cast<size_t>(next) : kRecords;
+    std::vector<TraceRecord> ordered;
+    ordered.reserve(count);
+    for (uint64_t i = next - count; i < next; ++i) {
+        ordered.push_back(records[i & (kRecords - 1)]);
+    }
+    return ordered;
+}
+
+void TraceRing::dump(const std::string& filename) const {
+    std::ofstream out(filename, std::ios::binary);
+    if (!out.is_open()) {
+        throw std::runtime_error("Could not open trace file: " + filename);
+    }
+    std::vector<TraceRecord> ordered = snapshot();
+    uint32_t count = static_cast<uint32_t>(ordered.size());
+    out.write(kTraceMagic, sizeof(kTraceMagic));
+    out.write(reinterpret_cast<const char*>(&next), sizeof(next));
+    out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    out.write(reinterpret_cast<const char*>(ordered.data()), count * sizeof(TraceRecord));
+}
+
+std::vector<TraceRecord> TraceRing::load(const std::string& filename, uint64_t& total_recorded) {
+    std::ifstream in(filename, std::ios::binary);
+    if (!in.is_open()) {
+        throw std::runtime_error("Could not open trace file: " + filename);
+    }
+    char magic[sizeof(kTraceMagic)];
+    uint32_t count = 0;
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(&total_recorded), sizeof(total_recorded));
+    in.read(reinterpret_cast<char*>(&count), sizeof(count));
+    if (!in || std::memcmp(magic, kTraceMagic, sizeof(magic)) != 0) {
+        throw std::runtime_error("Not a VM trace file: " + filename);
+    }
+    std::vector<TraceRecord> ordered(count);
+    in.read(reinterpret_cast<char*>(ordered.data()), count * sizeof(TraceRecord));
+    if (!in) {
+        throw std::runtime_error("Truncated trace file: " + filename);
+    }
+    return ordered;
+}
@@ -0,0 +1,50 @@
+#ifndef VM_TRACE_HPP
+#define VM_TRACE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One executed instruction as seen just before it runs. Records are written
+// to the dump file as-is, in host byte order.
+struct TraceRecord {
+    uint32_t pc;     // index into the simulator's decoded code
+    uint32_t opcode; // OpCode value
+    int32_t tos;     // top of the operand stack, 0 when empty
+    uint32_t depth;  // operand stack depth
+};
+
+// Fixed-size in-memory ring of the most recent TraceRecords. Recording is a
+// store and an increment; older records are overwritten once the ring is
+// full.
+class TraceRing {
+public:
+    static const size_t kRecords = 1 << 16; // power of two
+
+    TraceRing();
+
+    void record(uint32_t pc, uint32_t opcode, int32_t tos, uint32_t depth) {
+        TraceRecord& r = records[next & (kRecords - 1)];
+        r.pc = pc;
+        r.opcode = opcode;
+        r.tos = tos;
+        r.depth = depth;
+        ++next;
+    }
+
+    uint64_t totalRecorded() const;
+
+    // Records still held, oldest first
+    std::vector<TraceRecord> snapshot() const;
+
+    // File layout: "VMTRACE1", uint64 total recorded, uint32 count, then
+    // `count` TraceRecords oldest first.
+    void dump(const std::string& filename) const;
+    static std::vector<TraceRecord> load(const std::string& filename, uint64_t& total_recorded);
+
+private:
+    std::vector<TraceRecord> records;
+    uint64_t next;
+};
+
+#endif
@@ -0,0 +1,24 @@
+#!/bin/bash
+# Runs every .asm here on the VM simulator and on the MIPS simulator, with
+# the default passes and with all of them off, and reports the cases whose
+# output or exit value differ.
+# usage: check.sh [path to vm_parser]
+here=$(cd "$(dirname "$0")" && pwd)
+vm=$(realpath "${1:-$here/../../Parser/src/vm_parser}")
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+cd "$work" || exit 1
+
+bad=0
+for flags in "" "--no-fold --no-inline --no-peephole --no-schedule"; do
+  for f in "$here"/*.asm; do
+    v=$("$vm" "$f" $flags --quiet --simulate 2>&1 | grep -B1 -E "^Exit value|^Error" | sed 's/ (.*//;s/Exit value: //' | tr '\n' ' ')
+    m=$("$vm" "$f" $flags --quiet --run-mips 2>&1 | sed -n '/MIPS Simulation/,$p' | grep -vE "MIPS Simulation|^\s*$" | sed 's/ (.*//;s/MIPS exit code: //' | tr '\n' ' ')
+    if [ -z "$v" ] || [ "$v" != "$m" ]; then
+      bad=$((bad+1))
+      echo "$(basename "$f") ${flags:-(default)}: vm=[$v] mips=[$m]"
+    fi
+  done
+done
+echo "mismatches: $bad"
+[ $bad -eq 0 ]
@@ -0,0 +1,80 @@
+// Constant indices and sizes: NEW_ARRAY and NEW_STRING of a constant
+// size, element and character accesses at constant indices, which become
+// load and store offsets, and one loop over a variable index.
+// Prints 35, Hi! and 105, exits with 47.
+
+4F 41 54 53 FB 00 00 00 00 00 00 00 13 00 00 00 00 00 00 00 // "OATS", code 251 bytes, no data, symbols 19 bytes
+
+// main:  (offset 0)
+01 03 00 00 00                 //    0  ICONST 3
+10                             //    5  NEW_ARRAY
+09 00 00 00 00                 //    6  ISTORE 0
+0A 00 00 00 00                 //   11  ILOAD 0
+01 00 00 00 00                 //   16  ICONST 0
+01 05 00 00 00                 //   21  ICONST 5
+11                             //   26  SET_ELEM
+0A 00 00 00 00                 //   27  ILOAD 0
+01 02 00 00 00                 //   32  ICONST 2
+01 07 00 00 00                 //   37  ICONST 7
+11                             //   42  SET_ELEM
+0A 00 00 00 00                 //   43  ILOAD 0
+01 01 00 00 00                 //   48  ICONST 1
+0A 00 00 00 00                 //   53  ILOAD 0
+01 00 00 00 00                 //   58  ICONST 0
+12                             //   63  GET_ELEM
+0A 00 00 00 00                 //   64  ILOAD 0
+01 02 00 00 00                 //   69  ICONST 2
+12                             //   74  GET_ELEM
+04                             //   75  IMUL
+11                             //   76  SET_ELEM
+0A 00 00 00 00                 //   77  ILOAD 0
+01 01 00 00 00                 //   82  ICONST 1
+12                             //   87  GET_ELEM
+30                             //   88  PRINT_I
+01 03 00 00 00                 //   89  ICONST 3
+13                             //   94  NEW_STRING
+09 01 00 00 00                 //   95  ISTORE 1
+0A 01 00 00 00                 //  100  ILOAD 1
+01 00 00 00 00                 //  105  ICONST 0
+01 48 00 00 00                 //  110  ICONST 72
+14                             //  115  SET_CHAR
+0A 01 00 00 00                 //  116  ILOAD 1
+01 01 00 00 00                 //  121  ICONST 1
+01 69 00 00 00                 //  126  ICONST 105
+14                             //  131  SET_CHAR
+0A 01 00 00 00                 //  132  ILOAD 1
+01 02 00 00 00                 //  137  ICONST 2
+01 21 00 00 00                 //  142  ICONST 33
+14                             //  147  SET_CHAR
+0A 01 00 00 00                 //  148  ILOAD 1
+31                             //  153  PRINT_S
+0A 01 00 00 00                 //  154  ILOAD 1
+01 01 00 00 00                 //  159  ICONST 1
+15                             //  164  GET_CHAR
+30                             //  165  PRINT_I
+01 00 00 00 00                 //  166  ICONST 0
+09 02 00 00 00                 //  171  ISTORE 2
+01 00 00 00 00                 //  176  ICONST 0
+09 03 00 00 00                 //  181  ISTORE 3
+// sum:  (offset 186)
+0A 03 00 00 00                 //  186  ILOAD 3
+01 03 00 00 00                 //  191  ICONST 3
+21                             //  196  ICMP_LT
+23 F5 00 00 00                 //  197  JMP_IF_FALSE end
+0A 02 00 00 00                 //  202  ILOAD 2
+0A 00 00 00 00                 //  207  ILOAD 0
+0A 03 00 00 00                 //  212  ILOAD 3
+12                             //  217  GET_ELEM
+02                             //  218  IADD
+09 02 00 00 00                 //  219  ISTORE 2
+0A 03 00 00 00                 //  224  ILOAD 3
+01 01 00 00 00                 //  229  ICONST 1
+02                             //  234  IADD
+09 03 00 00 00                 //  235  ISTORE 3
+07 BA 00 00 00                 //  240  JMP sum
+// end:  (offset 245)
+0A 02 00 00 00                 //  245  ILOAD 2
+06                             //  250  RET
+
+01 00 00 00                    // 1 symbols
+04 00 00 00 6D 61 69 6E 00 01 01 00 00 00 00 // main: TEXT, global, defined, at 0
@@ -0,0 +1,24 @@
+// Epilogue: main returns on one path and jumps to the end of the code on
+// the other, so the default exit sequence is still needed.
+// Prints 42, exits with 7.
+
+4F 41 54 53 30 00 00 00 00 00 00 00 13 00 00 00 00 00 00 00 // "OATS", code 48 bytes, no data, symbols 19 bytes
+
+// main:  (offset 0)
+01 05 00 00 00                 //    0  ICONST 5
+09 00 00 00 00                 //    5  ISTORE 0
+0A 00 00 00 00                 //   10  ILOAD 0
+01 03 00 00 00                 //   15  ICONST 3
+22                             //   20  ICMP_GT
+23 2A 00 00 00                 //   21  JMP_IF_FALSE early
+01 2A 00 00 00                 //   26  ICONST 42
+30                             //   31  PRINT_I
+01 07 00 00 00                 //   32  ICONST 7
+07 30 00 00 00                 //   37  JMP end
+// early:  (offset 42)
+01 01 00 00 00                 //   42  ICONST 1
+06                             //   47  RET
+// end:  (offset 48)
+
+01 00 00 00                    // 1 symbols
+04 00 00 00 6D 61 69 6E 00 01 01 00 00 00 00 // main: TEXT, global, defined, at 0
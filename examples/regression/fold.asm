@@ -0,0 +1,59 @@
+// Constant folding: arithmetic on constants, a branch on a known
+// condition, and a local that holds the same constant on both paths into
+// a merge.
+// Prints 130, 42, 6 then 5, exits with 42.
+
+4F 41 54 53 A4 00 00 00 00 00 00 00 22 00 00 00 00 00 00 00 // "OATS", code 164 bytes, no data, symbols 34 bytes
+
+// main:  (offset 0)
+01 0D 00 00 00                 //    0  ICONST 13
+01 0A 00 00 00                 //    5  ICONST 10
+04                             //   10  IMUL
+30                             //   11  PRINT_I
+01 06 00 00 00                 //   12  ICONST 6
+09 00 00 00 00                 //   17  ISTORE 0
+0A 00 00 00 00                 //   22  ILOAD 0
+01 04 00 00 00                 //   27  ICONST 4
+22                             //   32  ICMP_GT
+23 3B 00 00 00                 //   33  JMP_IF_FALSE never
+0A 00 00 00 00                 //   38  ILOAD 0
+01 07 00 00 00                 //   43  ICONST 7
+04                             //   48  IMUL
+09 01 00 00 00                 //   49  ISTORE 1
+07 45 00 00 00                 //   54  JMP after
+// never:  (offset 59)
+01 00 00 00 00                 //   59  ICONST 0
+09 01 00 00 00                 //   64  ISTORE 1
+// after:  (offset 69)
+0A 01 00 00 00                 //   69  ILOAD 1
+30                             //   74  PRINT_I
+01 01 00 00 00                 //   75  ICONST 1
+08 75 00 00 00 01              //   80  INVOKE pick 1
+30                             //   86  PRINT_I
+01 00 00 00 00                 //   87  ICONST 0
+08 75 00 00 00 01              //   92  INVOKE pick 1
+30                             //   98  PRINT_I
+01 64 00 00 00                 //   99  ICONST 100
+01 07 00 00 00                 //  104  ICONST 7
+05                             //  109  IDIV
+01 03 00 00 00                 //  110  ICONST 3
+04                             //  115  IMUL
+06                             //  116  RET
+// pick:  (offset 117)
+0A 00 00 00 00                 //  117  ILOAD 0
+23 8E 00 00 00                 //  122  JMP_IF_FALSE zero
+01 05 00 00 00                 //  127  ICONST 5
+09 01 00 00 00                 //  132  ISTORE 1
+07 98 00 00 00                 //  137  JMP done
+// zero:  (offset 142)
+01 05 00 00 00                 //  142  ICONST 5
+09 01 00 00 00                 //  147  ISTORE 1
+// done:  (offset 152)
+0A 01 00 00 00                 //  152  ILOAD 1
+0A 00 00 00 00                 //  157  ILOAD 0
+02                             //  162  IADD
+06                             //  163  RET
+
+02 00 00 00                    // 2 symbols
+04 00 00 00 6D 61 69 6E 00 01 01 00 00 00 00 // main: TEXT, global, defined, at 0
+04 00 00 00 70 69 63 6B 00 01 01 75 00 00 00 // pick: TEXT, global, defined, at 117
@@ -0,0 +1,80 @@
+// Inliner: small callees inside a loop, a callee with two RETs, and a
+// recursive function that must stay a call.
+// Prints 20 then 0, exits with 3628800.
+
+4F 41 54 53 E0 00 00 00 00 00 00 00 4F 00 00 00 00 00 00 00 // "OATS", code 224 bytes, no data, symbols 79 bytes
+
+// main:  (offset 0)
+01 00 00 00 00                 //    0  ICONST 0
+09 00 00 00 00                 //    5  ISTORE 0
+01 00 00 00 00                 //   10  ICONST 0
+09 01 00 00 00                 //   15  ISTORE 1
+// top:  (offset 20)
+0A 01 00 00 00                 //   20  ILOAD 1
+01 05 00 00 00                 //   25  ICONST 5
+21                             //   30  ICMP_LT
+23 54 00 00 00                 //   31  JMP_IF_FALSE out
+0A 00 00 00 00                 //   36  ILOAD 0
+0A 01 00 00 00                 //   41  ILOAD 1
+08 7E 00 00 00 01              //   46  INVOKE twice 1
+08 8A 00 00 00 02              //   52  INVOKE add 2
+09 00 00 00 00                 //   58  ISTORE 0
+0A 01 00 00 00                 //   63  ILOAD 1
+01 01 00 00 00                 //   68  ICONST 1
+02                             //   73  IADD
+09 01 00 00 00                 //   74  ISTORE 1
+07 14 00 00 00                 //   79  JMP top
+// out:  (offset 84)
+0A 00 00 00 00                 //   84  ILOAD 0
+30                             //   89  PRINT_I
+01 03 00 00 00                 //   90  ICONST 3
+08 96 00 00 00 01              //   95  INVOKE sign 1
+01 F8 FF FF FF                 //  101  ICONST -8
+08 96 00 00 00 01              //  106  INVOKE sign 1
+02                             //  112  IADD
+30                             //  113  PRINT_I
+01 0A 00 00 00                 //  114  ICONST 10
+08 B2 00 00 00 01              //  119  INVOKE fact 1
+06                             //  125  RET
+// twice:  (offset 126)
+0A 00 00 00 00                 //  126  ILOAD 0
+01 02 00 00 00                 //  131  ICONST 2
+04                             //  136  IMUL
+06                             //  137  RET
+// add:  (offset 138)
+0A 00 00 00 00                 //  138  ILOAD 0
+0A 01 00 00 00                 //  143  ILOAD 1
+02                             //  148  IADD
+06                             //  149  RET
+// sign:  (offset 150)
+0A 00 00 00 00                 //  150  ILOAD 0
+01 00 00 00 00                 //  155  ICONST 0
+21                             //  160  ICMP_LT
+23 AC 00 00 00                 //  161  JMP_IF_FALSE nonneg
+01 FF FF FF FF                 //  166  ICONST -1
+06                             //  171  RET
+// nonneg:  (offset 172)
+01 01 00 00 00                 //  172  ICONST 1
+06                             //  177  RET
+// fact:  (offset 178)
+0A 00 00 00 00                 //  178  ILOAD 0
+01 02 00 00 00                 //  183  ICONST 2
+21                             //  188  ICMP_LT
+23 C8 00 00 00                 //  189  JMP_IF_FALSE rec
+01 01 00 00 00                 //  194  ICONST 1
+06                             //  199  RET
+// rec:  (offset 200)
+0A 00 00 00 00                 //  200  ILOAD 0
+0A 00 00 00 00                 //  205  ILOAD 0
+01 01 00 00 00                 //  210  ICONST 1
+03                             //  215  ISUB
+08 B2 00 00 00 01              //  216  INVOKE fact 1
+04                             //  222  IMUL
+06                             //  223  RET
+
+05 00 00 00                    // 5 symbols
+04 00 00 00 6D 61 69 6E 00 01 01 00 00 00 00 // main: TEXT, global, defined, at 0
+05 00 00 00 74 77 69 63 65 00 01 01 7E 00 00 00 // twice: TEXT, global, defined, at 126
+03 00 00 00 61 64 64 00 01 01 8A 00 00 00 // add: TEXT, global, defined, at 138
+04 00 00 00 73 69 67 6E 00 01 01 96 00 00 00 // sign: TEXT, global, defined, at 150
+04 00 00 00 66 61 63 74 00 01 01 B2 00 00 00 // fact: TEXT, global, defined, at 178
@@ -0,0 +1,112 @@
+// Loop promotion: nested loops whose inner one keeps its locals in
+// registers, a loop that calls a function (with --no-inline) so its
+// locals live in $s registers, and a loop with two exits that must both
+// store back.
+// Prints 71 then 385, exits with 8.
+
+4F 41 54 53 54 01 00 00 00 00 00 00 41 00 00 00 00 00 00 00 // "OATS", code 340 bytes, no data, symbols 65 bytes
+
+// main:  (offset 0)
+01 00 00 00 00                 //    0  ICONST 0
+09 00 00 00 00                 //    5  ISTORE 0
+01 00 00 00 00                 //   10  ICONST 0
+09 01 00 00 00                 //   15  ISTORE 1
+// outer:  (offset 20)
+0A 01 00 00 00                 //   20  ILOAD 1
+01 04 00 00 00                 //   25  ICONST 4
+21                             //   30  ICMP_LT
+23 84 00 00 00                 //   31  JMP_IF_FALSE done
+01 00 00 00 00                 //   36  ICONST 0
+09 02 00 00 00                 //   41  ISTORE 2
+// inner:  (offset 46)
+0A 02 00 00 00                 //   46  ILOAD 2
+0A 01 00 00 00                 //   51  ILOAD 1
+01 03 00 00 00                 //   56  ICONST 3
+02                             //   61  IADD
+21                             //   62  ICMP_LT
+23 6F 00 00 00                 //   63  JMP_IF_FALSE next
+0A 00 00 00 00                 //   68  ILOAD 0
+0A 01 00 00 00                 //   73  ILOAD 1
+0A 02 00 00 00                 //   78  ILOAD 2
+04                             //   83  IMUL
+02                             //   84  IADD
+09 00 00 00 00                 //   85  ISTORE 0
+0A 02 00 00 00                 //   90  ILOAD 2
+01 01 00 00 00                 //   95  ICONST 1
+02                             //  100  IADD
+09 02 00 00 00                 //  101  ISTORE 2
+07 2E 00 00 00                 //  106  JMP inner
+// next:  (offset 111)
+0A 01 00 00 00                 //  111  ILOAD 1
+01 01 00 00 00                 //  116  ICONST 1
+02                             //  121  IADD
+09 01 00 00 00                 //  122  ISTORE 1
+07 14 00 00 00                 //  127  JMP outer
+// done:  (offset 132)
+0A 00 00 00 00                 //  132  ILOAD 0
+30                             //  137  PRINT_I
+01 0A 00 00 00                 //  138  ICONST 10
+08 A2 00 00 00 01              //  143  INVOKE squares 1
+30                             //  149  PRINT_I
+01 32 00 00 00                 //  150  ICONST 50
+08 03 01 00 00 01              //  155  INVOKE root 1
+06                             //  161  RET
+// squares:  (offset 162)
+01 00 00 00 00                 //  162  ICONST 0
+09 01 00 00 00                 //  167  ISTORE 1
+01 01 00 00 00                 //  172  ICONST 1
+09 02 00 00 00                 //  177  ISTORE 2
+// sq_top:  (offset 182)
+0A 02 00 00 00                 //  182  ILOAD 2
+0A 00 00 00 00                 //  187  ILOAD 0
+22                             //  192  ICMP_GT
+24 F1 00 00 00                 //  193  JNZ sq_out
+0A 01 00 00 00                 //  198  ILOAD 1
+0A 02 00 00 00                 //  203  ILOAD 2
+08 F7 00 00 00 01              //  208  INVOKE sq 1
+02                             //  214  IADD
+09 01 00 00 00                 //  215  ISTORE 1
+0A 02 00 00 00                 //  220  ILOAD 2
+01 01 00 00 00                 //  225  ICONST 1
+02                             //  230  IADD
+09 02 00 00 00                 //  231  ISTORE 2
+07 B6 00 00 00                 //  236  JMP sq_top
+// sq_out:  (offset 241)
+0A 01 00 00 00                 //  241  ILOAD 1
+06                             //  246  RET
+// sq:  (offset 247)
+0A 00 00 00 00                 //  247  ILOAD 0
+0A 00 00 00 00                 //  252  ILOAD 0
+04                             //  257  IMUL
+06                             //  258  RET
+// root:  (offset 259)
+01 00 00 00 00                 //  259  ICONST 0
+09 01 00 00 00                 //  264  ISTORE 1
+// r_top:  (offset 269)
+0A 01 00 00 00                 //  269  ILOAD 1
+0A 01 00 00 00                 //  274  ILOAD 1
+04                             //  279  IMUL
+0A 00 00 00 00                 //  280  ILOAD 0
+22                             //  285  ICMP_GT
+24 48 01 00 00                 //  286  JNZ r_found
+0A 01 00 00 00                 //  291  ILOAD 1
+01 64 00 00 00                 //  296  ICONST 100
+20                             //  301  ICMP_EQ
+24 4E 01 00 00                 //  302  JNZ r_none
+0A 01 00 00 00                 //  307  ILOAD 1
+01 01 00 00 00                 //  312  ICONST 1
+02                             //  317  IADD
+09 01 00 00 00                 //  318  ISTORE 1
+07 0D 01 00 00                 //  323  JMP r_top
+// r_found:  (offset 328)
+0A 01 00 00 00                 //  328  ILOAD 1
+06                             //  333  RET
+// r_none:  (offset 334)
+01 FF FF FF FF                 //  334  ICONST -1
+06                             //  339  RET
+
+04 00 00 00                    // 4 symbols
+04 00 00 00 6D 61 69 6E 00 01 01 00 00 00 00 // main: TEXT, global, defined, at 0
+07 00 00 00 73 71 75 61 72 65 73 00 01 01 A2 00 00 00 // squares: TEXT, global, defined, at 162
+02 00 00 00 73 71 00 01 01 F7 00 00 00 // sq: TEXT, global, defined, at 247
+04 00 00 00 72 6F 6F 74 00 01 01 03 01 00 00 // root: TEXT, global, defined, at 259
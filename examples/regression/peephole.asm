@@ -0,0 +1,66 @@
+// Peephole rules: a store then a reload of the same local (store-load),
+// an array base loaded again for every access (load-load), and a call
+// whose arguments sit above an earlier value.
+// Prints 33, 72 then 7, exits with 44.
+
+4F 41 54 53 BA 00 00 00 00 00 00 00 21 00 00 00 00 00 00 00 // "OATS", code 186 bytes, no data, symbols 33 bytes
+
+// main:  (offset 0)
+01 04 00 00 00                 //    0  ICONST 4
+10                             //    5  NEW_ARRAY
+09 00 00 00 00                 //    6  ISTORE 0
+0A 00 00 00 00                 //   11  ILOAD 0
+01 00 00 00 00                 //   16  ICONST 0
+01 0B 00 00 00                 //   21  ICONST 11
+11                             //   26  SET_ELEM
+0A 00 00 00 00                 //   27  ILOAD 0
+01 01 00 00 00                 //   32  ICONST 1
+01 16 00 00 00                 //   37  ICONST 22
+11                             //   42  SET_ELEM
+0A 00 00 00 00                 //   43  ILOAD 0
+01 02 00 00 00                 //   48  ICONST 2
+0A 00 00 00 00                 //   53  ILOAD 0
+01 00 00 00 00                 //   58  ICONST 0
+12                             //   63  GET_ELEM
+0A 00 00 00 00                 //   64  ILOAD 0
+01 01 00 00 00                 //   69  ICONST 1
+12                             //   74  GET_ELEM
+02                             //   75  IADD
+11                             //   76  SET_ELEM
+0A 00 00 00 00                 //   77  ILOAD 0
+01 02 00 00 00                 //   82  ICONST 2
+12                             //   87  GET_ELEM
+30                             //   88  PRINT_I
+01 09 00 00 00                 //   89  ICONST 9
+09 01 00 00 00                 //   94  ISTORE 1
+0A 01 00 00 00                 //   99  ILOAD 1
+0A 01 00 00 00                 //  104  ILOAD 1
+04                             //  109  IMUL
+09 02 00 00 00                 //  110  ISTORE 2
+0A 02 00 00 00                 //  115  ILOAD 2
+0A 01 00 00 00                 //  120  ILOAD 1
+03                             //  125  ISUB
+30                             //  126  PRINT_I
+01 01 00 00 00                 //  127  ICONST 1
+01 02 00 00 00                 //  132  ICONST 2
+01 04 00 00 00                 //  137  ICONST 4
+08 AE 00 00 00 02              //  142  INVOKE add 2
+02                             //  148  IADD
+30                             //  149  PRINT_I
+0A 00 00 00 00                 //  150  ILOAD 0
+01 02 00 00 00                 //  155  ICONST 2
+12                             //  160  GET_ELEM
+0A 00 00 00 00                 //  161  ILOAD 0
+01 00 00 00 00                 //  166  ICONST 0
+12                             //  171  GET_ELEM
+02                             //  172  IADD
+06                             //  173  RET
+// add:  (offset 174)
+0A 00 00 00 00                 //  174  ILOAD 0
+0A 01 00 00 00                 //  179  ILOAD 1
+02                             //  184  IADD
+06                             //  185  RET
+
+02 00 00 00                    // 2 symbols
+04 00 00 00 6D 61 69 6E 00 01 01 00 00 00 00 // main: TEXT, global, defined, at 0
+03 00 00 00 61 64 64 00 01 01 AE 00 00 00 // add: TEXT, global, defined, at 174
@@ -0,0 +1,70 @@
+// Scheduler: independent loads, multiplies and divides in one block, so
+// loads move away from their uses and delay slots get filled, in a loop
+// that runs the block several times. The operands are arguments, so
+// folding leaves the block alone.
+// Prints 3059, exits with 31.
+
+4F 41 54 53 BF 00 00 00 00 00 00 00 21 00 00 00 00 00 00 00 // "OATS", code 191 bytes, no data, symbols 33 bytes
+
+// main:  (offset 0)
+01 07 00 00 00                 //    0  ICONST 7
+01 03 00 00 00                 //    5  ICONST 3
+01 0C 00 00 00                 //   10  ICONST 12
+08 16 00 00 00 03              //   15  INVOKE mix 3
+06                             //   21  RET
+// mix:  (offset 22)
+01 00 00 00 00                 //   22  ICONST 0
+09 03 00 00 00                 //   27  ISTORE 3
+01 00 00 00 00                 //   32  ICONST 0
+09 04 00 00 00                 //   37  ISTORE 4
+// top:  (offset 42)
+0A 04 00 00 00                 //   42  ILOAD 4
+01 06 00 00 00                 //   47  ICONST 6
+21                             //   52  ICMP_LT
+23 8F 00 00 00                 //   53  JMP_IF_FALSE out
+0A 00 00 00 00                 //   58  ILOAD 0
+0A 04 00 00 00                 //   63  ILOAD 4
+04                             //   68  IMUL
+0A 01 00 00 00                 //   69  ILOAD 1
+0A 02 00 00 00                 //   74  ILOAD 2
+04                             //   79  IMUL
+02                             //   80  IADD
+0A 02 00 00 00                 //   81  ILOAD 2
+0A 04 00 00 00                 //   86  ILOAD 4
+01 01 00 00 00                 //   91  ICONST 1
+02                             //   96  IADD
+05                             //   97  IDIV
+0A 00 00 00 00                 //   98  ILOAD 0
+0A 01 00 00 00                 //  103  ILOAD 1
+03                             //  108  ISUB
+04                             //  109  IMUL
+02                             //  110  IADD
+0A 03 00 00 00                 //  111  ILOAD 3
+02                             //  116  IADD
+09 03 00 00 00                 //  117  ISTORE 3
+0A 04 00 00 00                 //  122  ILOAD 4
+01 01 00 00 00                 //  127  ICONST 1
+02                             //  132  IADD
+09 04 00 00 00                 //  133  ISTORE 4
+07 2A 00 00 00                 //  138  JMP top
+// out:  (offset 143)
+0A 03 00 00 00                 //  143  ILOAD 3
+0A 00 00 00 00                 //  148  ILOAD 0
+04                             //  153  IMUL
+30                             //  154  PRINT_I
+0A 00 00 00 00                 //  155  ILOAD 0
+0A 01 00 00 00                 //  160  ILOAD 1
+0A 02 00 00 00                 //  165  ILOAD 2
+02                             //  170  IADD
+04                             //  171  IMUL
+0A 04 00 00 00                 //  172  ILOAD 4
+03                             //  177  ISUB
+01 03 00 00 00                 //  178  ICONST 3
+05                             //  183  IDIV
+01 02 00 00 00                 //  184  ICONST 2
+03                             //  189  ISUB
+06                             //  190  RET
+
+02 00 00 00                    // 2 symbols
+04 00 00 00 6D 61 69 6E 00 01 01 00 00 00 00 // main: TEXT, global, defined, at 0
+03 00 00 00 6D 69 78 00 01 01 16 00 00 00 // mix: TEXT, global, defined, at 22
@@ -0,0 +1,62 @@
+// Strength reduction: multiplies and divides of a value the generator
+// cannot see by 0, 1, -1, 8, 10, 7, 4, -8, 7 and 1, for a positive and a
+// negative argument, so shifts, adds and magic reciprocals must round like
+// the VM's IDIV.
+// Exits with 0.
+
+4F 41 54 53 9A 00 00 00 00 00 00 00 22 00 00 00 00 00 00 00 // "OATS", code 154 bytes, no data, symbols 34 bytes
+
+// main:  (offset 0)
+01 64 00 00 00                 //    0  ICONST 100
+08 1C 00 00 00 01              //    5  INVOKE show 1
+01 B3 FF FF FF                 //   11  ICONST -77
+08 1C 00 00 00 01              //   16  INVOKE show 1
+01 00 00 00 00                 //   22  ICONST 0
+06                             //   27  RET
+// show:  (offset 28)
+0A 00 00 00 00                 //   28  ILOAD 0
+01 00 00 00 00                 //   33  ICONST 0
+04                             //   38  IMUL
+30                             //   39  PRINT_I
+0A 00 00 00 00                 //   40  ILOAD 0
+01 01 00 00 00                 //   45  ICONST 1
+04                             //   50  IMUL
+30                             //   51  PRINT_I
+0A 00 00 00 00                 //   52  ILOAD 0
+01 FF FF FF FF                 //   57  ICONST -1
+04                             //   62  IMUL
+30                             //   63  PRINT_I
+0A 00 00 00 00                 //   64  ILOAD 0
+01 08 00 00 00                 //   69  ICONST 8
+04                             //   74  IMUL
+30                             //   75  PRINT_I
+0A 00 00 00 00                 //   76  ILOAD 0
+01 0A 00 00 00                 //   81  ICONST 10
+04                             //   86  IMUL
+30                             //   87  PRINT_I
+0A 00 00 00 00                 //   88  ILOAD 0
+01 07 00 00 00                 //   93  ICONST 7
+04                             //   98  IMUL
+30                             //   99  PRINT_I
+0A 00 00 00 00                 //  100  ILOAD 0
+01 04 00 00 00                 //  105  ICONST 4
+05                             //  110  IDIV
+30                             //  111  PRINT_I
+0A 00 00 00 00                 //  112  ILOAD 0
+01 F8 FF FF FF                 //  117  ICONST -8
+05                             //  122  IDIV
+30                             //  123  PRINT_I
+0A 00 00 00 00                 //  124  ILOAD 0
+01 07 00 00 00                 //  129  ICONST 7
+05                             //  134  IDIV
+30                             //  135  PRINT_I
+0A 00 00 00 00                 //  136  ILOAD 0
+01 01 00 00 00                 //  141  ICONST 1
+05                             //  146  IDIV
+30                             //  147  PRINT_I
+01 00 00 00 00                 //  148  ICONST 0
+06                             //  153  RET
+
+02 00 00 00                    // 2 symbols
+04 00 00 00 6D 61 69 6E 00 01 01 00 00 00 00 // main: TEXT, global, defined, at 0
+04 00 00 00 73 68 6F 77 00 01 01 1C 00 00 00 // show: TEXT, global, defined, at 28
@@ -0,0 +1,57 @@
+// Verifier: the stack heights the generator takes from BytecodeVerifier.
+// A value left below a call survives it, two paths meet at the same
+// height, and a function with two RETs leaves one value at each.
+// Prints 125 then 27, exits with 13.
+
+4F 41 54 53 8E 00 00 00 00 00 00 00 2E 00 00 00 00 00 00 00 // "OATS", code 142 bytes, no data, symbols 46 bytes
+
+// main:  (offset 0)
+01 03 00 00 00                 //    0  ICONST 3
+09 00 00 00 00                 //    5  ISTORE 0
+01 64 00 00 00                 //   10  ICONST 100
+01 05 00 00 00                 //   15  ICONST 5
+08 60 00 00 00 01              //   20  INVOKE sq 1
+02                             //   26  IADD
+30                             //   27  PRINT_I
+01 07 00 00 00                 //   28  ICONST 7
+0A 00 00 00 00                 //   33  ILOAD 0
+01 02 00 00 00                 //   38  ICONST 2
+22                             //   43  ICMP_GT
+23 3B 00 00 00                 //   44  JMP_IF_FALSE small
+01 0A 00 00 00                 //   49  ICONST 10
+07 40 00 00 00                 //   54  JMP join
+// small:  (offset 59)
+01 14 00 00 00                 //   59  ICONST 20
+// join:  (offset 64)
+01 0A 00 00 00                 //   64  ICONST 10
+02                             //   69  IADD
+02                             //   70  IADD
+30                             //   71  PRINT_I
+01 F7 FF FF FF                 //   72  ICONST -9
+08 6C 00 00 00 01              //   77  INVOKE abs 1
+01 04 00 00 00                 //   83  ICONST 4
+08 6C 00 00 00 01              //   88  INVOKE abs 1
+02                             //   94  IADD
+06                             //   95  RET
+// sq:  (offset 96)
+0A 00 00 00 00                 //   96  ILOAD 0
+0A 00 00 00 00                 //  101  ILOAD 0
+04                             //  106  IMUL
+06                             //  107  RET
+// abs:  (offset 108)
+0A 00 00 00 00                 //  108  ILOAD 0
+01 00 00 00 00                 //  113  ICONST 0
+21                             //  118  ICMP_LT
+23 88 00 00 00                 //  119  JMP_IF_FALSE pos
+01 00 00 00 00                 //  124  ICONST 0
+0A 00 00 00 00                 //  129  ILOAD 0
+03                             //  134  ISUB
+06                             //  135  RET
+// pos:  (offset 136)
+0A 00 00 00 00                 //  136  ILOAD 0
+06                             //  141  RET
+
+03 00 00 00                    // 3 symbols
+04 00 00 00 6D 61 69 6E 00 01 01 00 00 00 00 // main: TEXT, global, defined, at 0
+02 00 00 00 73 71 00 01 01 60 00 00 00 // sq: TEXT, global, defined, at 96
+03 00 00 00 61 62 73 00 01 01 6C 00 00 00 // abs: TEXT, global, defined, at 108